@@ -0,0 +1,86 @@
+#ifndef ANALYSIS_BUFFER_H
+#define ANALYSIS_BUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// contiguous, cache-line aligned storage for analysis data
+// allocated once up front and reused, it never grows behind your back
+template <typename T>
+class AnalysisBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "analysis buffers hold plain sample data");
+
+public:
+    static const std::size_t alignment = 64;
+
+    AnalysisBuffer() {}
+    explicit AnalysisBuffer(std::size_t capacity) { reserve(capacity); }
+    ~AnalysisBuffer() { release(); }
+
+    AnalysisBuffer(const AnalysisBuffer&) = delete;
+    AnalysisBuffer& operator=(const AnalysisBuffer&) = delete;
+
+    AnalysisBuffer(AnalysisBuffer&& other) noexcept { swap(other); }
+    AnalysisBuffer& operator=(AnalysisBuffer&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    // only reallocates when asked for more room than we already have
+    void reserve(std::size_t capacity)
+    {
+        if (capacity <= buf_capacity) {
+            return;
+        }
+        release();
+        buf = static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignment)));
+        buf_capacity = capacity;
+    }
+
+    // size is clamped to the capacity, contents are left as they were
+    void resize(std::size_t size) { buf_size = std::min(size, buf_capacity); }
+    void clear() { buf_size = 0; }
+
+    T* data() { return buf; }
+    const T* data() const { return buf; }
+    std::size_t size() const { return buf_size; }
+    std::size_t capacity() const { return buf_capacity; }
+    bool empty() const { return buf_size == 0; }
+
+    T& operator[](std::size_t i) { return buf[i]; }
+    const T& operator[](std::size_t i) const { return buf[i]; }
+
+    T* begin() { return buf; }
+    T* end() { return buf + buf_size; }
+    const T* begin() const { return buf; }
+    const T* end() const { return buf + buf_size; }
+
+    void swap(AnalysisBuffer& other) noexcept
+    {
+        std::swap(buf, other.buf);
+        std::swap(buf_size, other.buf_size);
+        std::swap(buf_capacity, other.buf_capacity);
+    }
+
+private:
+    void release()
+    {
+        if (buf != nullptr) {
+            ::operator delete(buf, std::align_val_t(alignment));
+        }
+        buf = nullptr;
+        buf_size = 0;
+        buf_capacity = 0;
+    }
+
+    T* buf = nullptr;
+    std::size_t buf_size = 0;
+    std::size_t buf_capacity = 0;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "analysis_thread.h"
+#include "analysis_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+void AnalysisThread::start(EnvelopeSource* envelope, SpectrumSource* spectrum, double rate, double lookahead, bool realtime)
+{
+    stop();
+    this->envelope = envelope;
+    this->spectrum = spectrum;
+    this->live = nullptr;
+    this->rate = rate;
+    this->lookahead = lookahead;
+    this->realtime = realtime;
+
+    // room for the whole lookahead, twice over so the producer rarely finds it full
+    std::size_t capacity = (std::size_t) std::ceil(rate * lookahead) * 2 + 2;
+    ring = std::make_unique<SpscRing<FeatureFrame>>(capacity);
+    if (window_stream != nullptr) {
+        window_samples = std::make_unique<SpscRing<float>>(capacity * window_size);
+        window_seconds = std::make_unique<SpscRing<double>>(capacity);
+    } else {
+        window_samples.reset();
+        window_seconds.reset();
+    }
+    have_pending_window = false;
+    previous = std::make_unique<FeatureFrame>();
+    next = std::make_unique<FeatureFrame>();
+    have_previous = have_next = false;
+    stopping = false;
+    worker = std::thread(&AnalysisThread::runFile, this);
+}
+
+void AnalysisThread::produceWindows(AudioStream* stream, std::size_t size, std::size_t hop)
+{
+    window_stream = stream;
+    window_size = size;
+    window_hop = std::max<std::size_t>(1, hop);
+}
+
+void AnalysisThread::startLive(LiveAnalyzer* live)
+{
+    stop();
+    window_stream = nullptr;
+    this->envelope = nullptr;
+    this->spectrum = live;
+    this->live = live;
+    ring = std::make_unique<SpscRing<FeatureFrame>>(64);
+    previous = std::make_unique<FeatureFrame>();
+    next = std::make_unique<FeatureFrame>();
+    have_previous = have_next = false;
+    stopping = false;
+    worker = std::thread(&AnalysisThread::runLive, this);
+}
+
+void AnalysisThread::stop()
+{
+    stopping = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void AnalysisThread::fill(FeatureFrame& frame, double seconds)
+{
+    frame.seconds = seconds;
+    frame.band_count = 0;
+    if (spectrum != nullptr) {
+        spectrum->update(seconds);
+        frame.band_count = (std::uint32_t) std::min(spectrum->getBandCount(), FeatureFrame::max_bands);
+        std::memcpy(frame.bands, spectrum->getBands(), frame.band_count * sizeof(float));
+    }
+}
+
+void AnalysisThread::runFile()
+{
+    std::unique_ptr<FeatureFrame> frame = std::make_unique<FeatureFrame>();
+    AnalysisBuffer<sf::Int16> raw;
+    AnalysisBuffer<float> mono;
+    if (window_stream != nullptr) {
+        raw.reserve(window_size * window_stream->getChannelCount());
+        raw.resize(window_size * window_stream->getChannelCount());
+        mono.reserve(window_size);
+        mono.resize(window_size);
+    }
+    long long last_window = -1;
+    double step = 1.0 / rate;
+    double time = render_seconds.load(std::memory_order_acquire);
+    while (!stopping) {
+        double render = render_seconds.load(std::memory_order_acquire);
+        if (realtime && time < render - step) {
+            time = render; // fell behind, catching up would only make it worse
+        }
+        bool windows_full = window_stream != nullptr &&
+                            (window_seconds->writable() == 0 || window_samples->writable() < window_size);
+        if (time > render + lookahead || ring->writable() == 0 || windows_full) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // a new window once we have moved at least one hop; it goes in before
+        // the frame, so a renderer that waited for the frame also has the window
+        if (window_stream != nullptr) {
+            long long centre = (long long) (time * window_stream->getSampleRate());
+            if (last_window < 0 || std::llabs(centre - last_window) >= (long long) window_hop) {
+                readMonoWindow(*window_stream, centre, window_size, raw.data(), mono.data());
+                window_samples->push(mono.data(), window_size);
+                window_seconds->tryPush(time);
+                last_window = centre;
+            }
+        }
+
+        EnvelopeValue value = envelope->sample(envelope->positionAt(time));
+        frame->peak = value.peak;
+        frame->rms = value.rms;
+        fill(*frame, time);
+        ring->tryPush(*frame);
+        time += step;
+    }
+}
+
+void AnalysisThread::runLive()
+{
+    std::unique_ptr<FeatureFrame> frame = std::make_unique<FeatureFrame>();
+    while (!stopping) {
+        live->consume();
+        if (live->getConsumedArrival() <= 0.0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        EnvelopeValue value = live->getLevel();
+        frame->peak = value.peak;
+        frame->rms = value.rms;
+        fill(*frame, live->getConsumedArrival());
+        ring->tryPush(*frame); // a full ring means the renderer stalled, it only wants the newest anyway
+    }
+}
+
+bool AnalysisThread::takeWindow(double seconds, float* mono)
+{
+    if (!window_seconds) {
+        return false;
+    }
+
+    // skip to the newest one that is due, older ones are of no use any more
+    bool taken = false;
+    for (;;) {
+        if (!have_pending_window) {
+            if (!window_seconds->tryPop(pending_window)) {
+                break;
+            }
+            have_pending_window = true;
+        }
+        if (pending_window > seconds) {
+            break;
+        }
+        window_samples->pop(mono, window_size); // its samples went in first, so they are all there
+        have_pending_window = false;
+        taken = true;
+    }
+    return taken;
+}
+
+bool AnalysisThread::sample(double seconds, FeatureFrame& out, bool wait)
+{
+    render_seconds.store(seconds, std::memory_order_release);
+
+    // move along until the next frame is at or after the wanted time
+    for (;;) {
+        while (!have_next || next->seconds < seconds) {
+            if (ring->readable() == 0) {
+                break;
+            }
+            std::swap(previous, next);
+            have_previous = have_next;
+            ring->tryPop(*next);
+            have_next = true;
+        }
+        if (!wait || (have_next && next->seconds >= seconds) || stopping) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    if (!have_next) {
+        return false;
+    }
+
+    if (next->seconds < seconds) {
+        // the analyzer is behind, or this is a live input, the newest will have to do
+        if (seconds - next->seconds > 1.0 / rate && !live) {
+            late_frames++;
+        }
+        out = *next;
+        return true;
+    }
+    if (!have_previous || previous->seconds > seconds) {
+        out = *next;
+        return true;
+    }
+
+    float t = (float) ((seconds - previous->seconds) / std::max(next->seconds - previous->seconds, 1e-9));
+    out.seconds = seconds;
+    out.peak = previous->peak + (next->peak - previous->peak) * t;
+    out.rms = previous->rms + (next->rms - previous->rms) * t;
+    out.band_count = std::min(previous->band_count, next->band_count);
+    for (std::uint32_t b = 0; b < out.band_count; b++) {
+        out.bands[b] = previous->bands[b] + (next->bands[b] - previous->bands[b]) * t;
+    }
+    return true;
+}
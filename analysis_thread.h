@@ -0,0 +1,96 @@
+#ifndef ANALYSIS_THREAD_H
+#define ANALYSIS_THREAD_H
+
+#include "capture.h"
+#include "envelope.h"
+#include "spectrum.h"
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// everything the visuals need about one moment of audio
+struct FeatureFrame
+{
+    static const std::size_t max_bands = 512;
+
+    double seconds; // track time it describes, or the arrival time for a live input
+    float peak;
+    float rms;
+    std::uint32_t band_count; // 0 when the spectrum is done elsewhere
+    float bands[max_bands];
+};
+
+// runs the envelope and spectrum on their own thread, ahead of the render
+// clock, and hands timestamped frames over through a wait-free ring; the
+// renderer only interpolates, so a slow analysis shows up as slightly stale
+// features rather than a dropped frame
+class AnalysisThread
+{
+public:
+    ~AnalysisThread() { stop(); }
+
+    // frames every 1 / rate seconds of track time, at most lookahead seconds
+    // ahead of the renderer; a realtime analyzer that falls behind skips ahead,
+    // otherwise it analyses every frame so the output never depends on timing
+    // spectrum may be null if something else provides the bands
+    void start(EnvelopeSource* envelope, SpectrumSource* spectrum, double rate, double lookahead, bool realtime);
+
+    // before start: also mix the mono window centred on every hop of stream,
+    // for an analyzer on the render thread that should only have to upload it
+    void produceWindows(AudioStream* stream, std::size_t size, std::size_t hop);
+
+    // a frame whenever new captured audio has come in
+    void startLive(LiveAnalyzer* live);
+
+    void stop();
+
+    // render side: the features for this time, interpolated between the frames
+    // around it; with wait it blocks until the analyzer has got that far,
+    // otherwise it settles for the newest frame; false before the first frame
+    bool sample(double seconds, FeatureFrame& out, bool wait);
+
+    // render side: the newest window centred at or before seconds, size floats
+    // into mono; false if no window has come in since the last one taken
+    bool takeWindow(double seconds, float* mono);
+
+    // render frames that had to make do with a frame older than they wanted
+    long long takeLateFrames() { return late_frames.exchange(0); }
+
+private:
+    void runFile();
+    void runLive();
+    void fill(FeatureFrame& frame, double seconds);
+
+    EnvelopeSource* envelope = nullptr;
+    SpectrumSource* spectrum = nullptr;
+    LiveAnalyzer* live = nullptr;
+    double rate = 100.0;
+    double lookahead = 0.25;
+    bool realtime = true;
+    AudioStream* window_stream = nullptr;
+    std::size_t window_size = 0;
+    std::size_t window_hop = 0;
+
+    std::unique_ptr<SpscRing<FeatureFrame>> ring;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    std::atomic<double> render_seconds{0.0};
+    std::atomic<long long> late_frames{0};
+
+    // whole windows back to back, each one's time is pushed after its samples
+    std::unique_ptr<SpscRing<float>> window_samples;
+    std::unique_ptr<SpscRing<double>> window_seconds;
+
+    // render side, the two frames around the last sampled time
+    std::unique_ptr<FeatureFrame> previous;
+    std::unique_ptr<FeatureFrame> next;
+    bool have_previous = false;
+    bool have_next = false;
+    double pending_window = 0.0;
+    bool have_pending_window = false;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "audio_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// marks a ring slot that holds nothing yet
+static const sf::Uint64 empty_slot = std::numeric_limits<sf::Uint64>::max();
+
+AudioStream::AudioStream(std::size_t block_frames, std::size_t block_count)
+    : block_frames(block_frames), block_count(block_count)
+{
+}
+
+bool AudioStream::open(const std::string& path)
+{
+    if (!file.openFromFile(path)) {
+        return false;
+    }
+    channel_count = file.getChannelCount();
+    sample_rate = file.getSampleRate();
+    sample_count = file.getSampleCount();
+
+    // blocks always hold whole frames so channels never straddle a boundary
+    block_size = block_frames * channel_count;
+    ring.assign(block_size * block_count, 0);
+    slot_block.assign(block_count, empty_slot);
+    next_block = 0;
+    return true;
+}
+
+std::size_t AudioStream::read(sf::Uint64 offset, sf::Int16* out, std::size_t count)
+{
+    if (offset >= sample_count) {
+        return 0;
+    }
+    count = (std::size_t) std::min<sf::Uint64>(count, sample_count - offset);
+
+    std::size_t copied = 0;
+    while (copied < count) {
+        sf::Uint64 pos = offset + copied;
+        sf::Uint64 block = pos / block_size;
+        std::size_t inner = (std::size_t) (pos % block_size);
+        std::size_t n = std::min(count - copied, block_size - inner);
+
+        const sf::Int16* data = fetchBlock(block);
+        std::memcpy(out + copied, data + inner, n * sizeof(sf::Int16));
+        copied += n;
+    }
+    return copied;
+}
+
+const sf::Int16* AudioStream::fetchBlock(sf::Uint64 block)
+{
+    std::size_t slot = (std::size_t) (block % block_count);
+    sf::Int16* data = &ring[slot * block_size];
+    if (slot_block[slot] == block) {
+        return data;
+    }
+
+    // only seek when we jump, sequential playback just keeps decoding
+    if (block != next_block) {
+        file.seek(block * block_size);
+    }
+    std::size_t got = (std::size_t) file.read(data, block_size);
+    std::fill(data + got, data + block_size, 0); // pad the final partial block
+    slot_block[slot] = block;
+    next_block = block + 1;
+    return data;
+}
@@ -0,0 +1,46 @@
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#include <SFML/Audio.hpp>
+
+#include <string>
+#include <vector>
+
+// streams an audio file in fixed-size blocks instead of decoding it all at once
+// decoded blocks live in a small ring, so memory use does not depend on track length
+class AudioStream
+{
+public:
+    // block_frames is the decode granularity, block_count the number of resident blocks
+    AudioStream(std::size_t block_frames = 4096, std::size_t block_count = 16);
+
+    bool open(const std::string& path);
+
+    unsigned int getChannelCount() const { return channel_count; }
+    unsigned int getSampleRate() const { return sample_rate; }
+
+    // total number of interleaved samples in the file
+    sf::Uint64 getSampleCount() const { return sample_count; }
+
+    // copy interleaved samples [offset, offset + count) into out, decoding blocks as needed
+    // returns how many samples were copied (less than count at the end of the file)
+    std::size_t read(sf::Uint64 offset, sf::Int16* out, std::size_t count);
+
+private:
+    // make sure the given block is resident and return its slot in the ring
+    const sf::Int16* fetchBlock(sf::Uint64 block);
+
+    sf::InputSoundFile file;
+    unsigned int channel_count = 0;
+    unsigned int sample_rate = 0;
+    sf::Uint64 sample_count = 0;
+
+    std::size_t block_frames;
+    std::size_t block_size = 0; // in interleaved samples
+    std::size_t block_count;
+    std::vector<sf::Int16> ring;
+    std::vector<sf::Uint64> slot_block; // which block each slot holds
+    sf::Uint64 next_block = 0; // block the decoder is positioned at
+};
+
+#endif
@@ -0,0 +1,13 @@
+#version 460 core
+out vec4 FragColor;
+
+in float height;
+in float level;
+
+void main()
+{
+    // loud bars glow white at the top, quiet ones stay blue
+    vec3 base = vec3(0.1f, 0.2f, 0.8f);
+    vec3 peak = mix(vec3(0.3f, 0.6f, 1.0f), vec3(1.0f, 1.0f, 1.0f), level);
+    FragColor = vec4(mix(base, peak, height), 1.0f);
+}
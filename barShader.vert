@@ -0,0 +1,26 @@
+#version 460 core
+out float height; // 0 at the bottom of a bar, 1 at its top
+out float level;
+
+uniform sampler1D spectrum;
+uniform int bar_count;
+
+void main()
+{
+    // two triangles per bar, the corner comes from the vertex id
+    const vec2 corners[6] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+                                   vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+    vec2 corner = corners[gl_VertexID];
+
+    // bars are spread over the whole spectrum, filtering fills in between bands
+    float centre = (float(gl_InstanceID) + 0.5) / float(bar_count);
+    level = textureLod(spectrum, centre, 0.0).r;
+
+    // leave gaps while bars are wide enough to see them
+    float width = 1.0 / float(bar_count);
+    float gap = bar_count > 512 ? 0.0 : 0.2 * width;
+    float x = float(gl_InstanceID) * width + gap * 0.5 + corner.x * (width - gap);
+    float y = corner.y * max(level, 0.005);
+    gl_Position = vec4(x * 2.0 - 1.0, y * 2.0 - 1.0, 0.0, 1.0);
+    height = corner.y;
+}
@@ -0,0 +1,507 @@
+// benchmarks for the audio preprocessing, built separately from the visualiser
+// everything is timed on synthetic tracks of a few lengths and channel counts,
+// and on a real track too if one is given
+
+#include <SFML/Audio.hpp>
+
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "decimate.h"
+#include "normalizer.h"
+#include "spectrum.h"
+#include "spsc_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one timed kernel on one input
+struct BenchResult
+{
+    std::string kernel;
+    std::string input;
+    unsigned int channels;
+    std::size_t samples; // values the kernel consumed, interleaved samples for pcm
+    std::size_t bytes; // bytes the kernel consumed
+    double seconds; // best of the repeats
+};
+
+// how long items waited somewhere, as a distribution rather than a rate
+struct LatencyResult
+{
+    std::string kernel;
+    std::string input;
+    std::size_t count; // items measured
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+    unsigned int cores; // hardware threads, with one the two sides take turns instead of running together
+    double mean_queued; // items still in the ring behind each one as it came out
+    std::size_t max_queued;
+};
+
+static const unsigned int sample_rate = 44100;
+
+// best time of a few runs, the first one also warms the caches
+static double timeBest(int repeat, const std::function<void()>& run)
+{
+    double best = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+    return best;
+}
+
+// a few detuned sines plus noise, so nothing is trivially predictable
+static void synthesize(std::vector<sf::Int16>& pcm, std::size_t frames, unsigned int channels)
+{
+    pcm.resize(frames * channels);
+    std::uint32_t noise = 12345;
+    for (std::size_t f = 0; f < frames; f++) {
+        double t = (double) f / sample_rate;
+        for (unsigned int c = 0; c < channels; c++) {
+            noise = noise * 1664525u + 1013904223u;
+            double v = 0.4 * std::sin(2.0 * 3.14159265358979 * (110.0 + 3.0 * c) * t)
+                     + 0.2 * std::sin(2.0 * 3.14159265358979 * 1760.0 * t)
+                     + 0.1 * ((double) (noise >> 8) / (double) (1u << 24) - 0.5);
+            pcm[f * channels + c] = (sf::Int16) std::lround(v * 32767.0);
+        }
+    }
+}
+
+// the kernels after decoding, all on the same pcm
+static void benchPcm(const std::vector<sf::Int16>& pcm, unsigned int channels, unsigned int rate,
+                     const std::string& input, int repeat, std::vector<BenchResult>& results)
+{
+    std::size_t frames = pcm.size() / channels;
+    std::size_t window_frames = std::max(1u, rate / 100);
+    std::size_t windows = frames / window_frames;
+
+    AnalysisBuffer<float> mono(frames);
+    mono.resize(frames);
+    double mix = timeBest(repeat, [&]() {
+        mixToMono(pcm.data(), frames, channels, mono.data());
+    });
+    results.push_back({"mix", input, channels, pcm.size(), pcm.size() * sizeof(sf::Int16), mix});
+
+    AnalysisBuffer<float> peak(windows), rms(windows);
+    peak.resize(windows);
+    rms.resize(windows);
+    double decimate = timeBest(repeat, [&]() {
+        decimateEnvelope(pcm.data(), frames, channels, window_frames, peak.data(), rms.data());
+    });
+    results.push_back({"decimate", input, channels, pcm.size(), pcm.size() * sizeof(sf::Int16), decimate});
+
+    // scale the envelope so its quietest window is 0 and its loudest is 1
+    AnalysisBuffer<float> normalized(windows);
+    normalized.resize(windows);
+    double normalize = timeBest(repeat, [&]() {
+        if (windows == 0) {
+            return;
+        }
+        auto range = std::minmax_element(rms.begin(), rms.end());
+        float low = *range.first;
+        float scale = *range.second > low ? 1.0f / (*range.second - low) : 0.0f;
+        for (std::size_t w = 0; w < windows; w++) {
+            normalized[w] = (rms[w] - low) * scale;
+        }
+    });
+    results.push_back({"normalize", input, channels, windows, windows * sizeof(float), normalize});
+
+    // the same envelope through the online normalizers, one window at a time as the render loop would
+    const NormalizeMode online[] = {NormalizeMode::Window, NormalizeMode::Agc};
+    for (NormalizeMode mode : online) {
+        NormalizeSettings normalize_settings;
+        normalize_settings.mode = mode;
+        double step = (double) window_frames / rate;
+        double seconds = timeBest(repeat, [&]() {
+            Normalizer normalizer(normalize_settings);
+            for (std::size_t w = 0; w < windows; w++) {
+                normalized[w] = normalizer.apply(rms[w], (double) w * step);
+            }
+        });
+        std::string kernel = std::string("normalize_") + normalizeModeName(mode);
+        results.push_back({kernel, input, channels, windows, windows * sizeof(float), seconds});
+    }
+
+    // one analysis per hop, counted by the mono frames it advances over
+    SpectrumSettings settings;
+    SpectrumAnalyzer analyzer(settings, rate);
+    std::size_t analyses = frames >= settings.fft_size ? (frames - settings.fft_size) / settings.hop + 1 : 0;
+    double spectrum = timeBest(repeat, [&]() {
+        for (std::size_t a = 0; a < analyses; a++) {
+            analyzer.analyze(mono.data() + a * settings.hop);
+        }
+    });
+    std::size_t covered = analyses * settings.hop;
+    results.push_back({"spectrum", input, 1, covered, covered * sizeof(float), spectrum});
+}
+
+// sequential decode of a whole file through the block ring
+static bool benchDecode(const std::string& path, int repeat, std::vector<BenchResult>& results,
+                        std::vector<sf::Int16>& pcm, unsigned int& channels, unsigned int& rate)
+{
+    AudioStream stream;
+    if (!stream.open(path)) {
+        return false;
+    }
+    channels = stream.getChannelCount();
+    rate = stream.getSampleRate();
+    pcm.resize((std::size_t) stream.getSampleCount());
+    double decode = timeBest(repeat, [&]() {
+        // a fresh stream each run, so every repeat really decodes
+        AudioStream fresh;
+        fresh.open(path);
+        const std::size_t chunk = 65536;
+        for (std::size_t offset = 0; offset < pcm.size(); offset += chunk) {
+            fresh.read(offset, pcm.data() + offset, std::min(chunk, pcm.size() - offset));
+        }
+    });
+    results.push_back({"decode", path, channels, pcm.size(), pcm.size() * sizeof(sf::Int16), decode});
+    return true;
+}
+
+// pcm blocks through the ring with both threads spinning on it the whole time
+static void benchRingThroughput(int repeat, std::vector<BenchResult>& results)
+{
+    const std::size_t block = 256; // samples per push, a small audio callback
+    const std::size_t total = 1 << 26;
+    SpscRing<sf::Int16> ring(1 << 14);
+    std::vector<sf::Int16> in(block, 1), out(block);
+    double seconds = timeBest(repeat, [&]() {
+        std::thread producer([&]() {
+            std::size_t sent = 0;
+            while (sent < total) {
+                std::size_t pushed = ring.push(in.data(), std::min(block, total - sent));
+                if (pushed == 0) {
+                    std::this_thread::yield(); // the other side may need this core
+                }
+                sent += pushed;
+            }
+        });
+        std::size_t received = 0;
+        while (received < total) {
+            std::size_t popped = ring.pop(out.data(), block);
+            if (popped == 0) {
+                std::this_thread::yield();
+            }
+            received += popped;
+        }
+        producer.join();
+    });
+    results.push_back({"ring", "pcm blocks of 256", 1, total, total * sizeof(sf::Int16), seconds});
+}
+
+static long long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a feature frame sized item with the time it was pushed
+struct StampedFrame
+{
+    long long sent_ns;
+    float values[14];
+};
+
+// frames pushed at a steady 2 MHz with the consumer spinning, how long each
+// one sat in the ring; the occupancy says whether that was a handoff or a queue,
+// a producer that keeps the ring full measures queueing, not the ring
+static void benchRingLatency(std::vector<LatencyResult>& latencies)
+{
+    const std::size_t count = 200000;
+    const long long interval_ns = 500;
+    SpscRing<StampedFrame> ring(1024);
+    std::vector<long long> latency(count);
+    std::thread producer([&]() {
+        StampedFrame frame = {};
+        long long start = nowNs();
+        for (std::size_t i = 0; i < count; i++) {
+            // yield while pacing, on one core a bare spin would starve the consumer
+            while (nowNs() < start + (long long) i * interval_ns) {
+                std::this_thread::yield();
+            }
+            frame.sent_ns = nowNs();
+            while (!ring.tryPush(frame)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    StampedFrame frame;
+    double queued_total = 0.0;
+    std::size_t max_queued = 0;
+    for (std::size_t received = 0; received < count;) {
+        if (ring.tryPop(frame)) {
+            latency[received++] = nowNs() - frame.sent_ns;
+            std::size_t queued = ring.readable();
+            queued_total += (double) queued;
+            max_queued = std::max(max_queued, queued);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    std::sort(latency.begin(), latency.end());
+    auto quantile = [&](double q) {
+        return (double) latency[std::min(count - 1, (std::size_t) (q * (double) count))];
+    };
+    latencies.push_back({"ring", "1024 frames at 2 MHz", count, quantile(0.5), quantile(0.99), quantile(0.999),
+                         (double) latency.back(), std::thread::hardware_concurrency(),
+                         queued_total / (double) count, max_queued});
+}
+
+// random sized bursts of a counting sequence through rings of awkward sizes,
+// checking every item comes out once and in order; returns false on any mistake
+static bool stressRing()
+{
+    const std::size_t capacities[] = {1, 2, 3, 64, 1000};
+    const std::uint64_t total = 5000000;
+    bool ok = true;
+    for (std::size_t capacity : capacities) {
+        SpscRing<std::uint64_t> ring(capacity);
+        std::thread producer([&]() {
+            std::vector<std::uint64_t> burst(700);
+            std::uint32_t random = 1;
+            for (std::uint64_t next = 0; next < total;) {
+                random = random * 1664525u + 1013904223u;
+                std::size_t pushed;
+                if (random >> 31) {
+                    pushed = ring.tryPush(next) ? 1 : 0;
+                } else {
+                    std::size_t count = std::min<std::uint64_t>(1 + (random >> 8) % burst.size(), total - next);
+                    for (std::size_t i = 0; i < count; i++) {
+                        burst[i] = next + i;
+                    }
+                    pushed = ring.push(burst.data(), count);
+                }
+                if (pushed == 0) {
+                    std::this_thread::yield();
+                }
+                next += pushed;
+            }
+        });
+
+        std::vector<std::uint64_t> burst(700);
+        std::uint32_t random = 7;
+        std::uint64_t errors = 0;
+        for (std::uint64_t expected = 0; expected < total;) {
+            random = random * 22695477u + 1u;
+            if (ring.readable() > ring.capacity()) {
+                errors++;
+            }
+            std::size_t got = ring.pop(burst.data(), 1 + (random >> 8) % burst.size());
+            for (std::size_t i = 0; i < got; i++) {
+                errors += burst[i] != expected + i;
+            }
+            if (got == 0) {
+                std::this_thread::yield();
+            }
+            expected += got;
+        }
+        producer.join();
+        printf("ring stress, capacity %zu: %llu items, %llu errors\n", ring.capacity(),
+               (unsigned long long) total, (unsigned long long) errors);
+        ok = ok && errors == 0;
+    }
+    return ok;
+}
+
+static void printTable(const std::vector<BenchResult>& results)
+{
+    printf("%-16s %-24s %3s %12s %10s %10s\n", "kernel", "input", "ch", "samples", "ns/sample", "MB/s");
+    for (const BenchResult& r : results) {
+        double ns = r.samples ? r.seconds * 1e9 / (double) r.samples : 0.0;
+        double mbs = r.seconds > 0.0 ? (double) r.bytes / r.seconds / 1e6 : 0.0;
+        printf("%-16s %-24s %3u %12zu %10.3f %10.1f\n", r.kernel.c_str(), r.input.c_str(), r.channels, r.samples, ns, mbs);
+    }
+}
+
+static void printLatencyTable(const std::vector<LatencyResult>& latencies)
+{
+    printf("\n%-16s %-24s %10s %10s %10s %10s %10s %10s\n", "kernel", "input", "p50 ns", "p99 ns", "p99.9 ns",
+           "max ns", "queued", "max queued");
+    for (const LatencyResult& r : latencies) {
+        printf("%-16s %-24s %10.0f %10.0f %10.0f %10.0f %10.1f %10zu\n", r.kernel.c_str(), r.input.c_str(),
+               r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns, r.mean_queued, r.max_queued);
+        if (r.cores < 2) {
+            printf("  only %u hardware thread, producer and consumer take turns so this is mostly scheduling\n", r.cores);
+        } else if (r.mean_queued > 1.0) {
+            printf("  the ring was rarely empty, this is time spent queued rather than handoff latency\n");
+        }
+    }
+}
+
+// a string as a json literal, quotes included; file names can hold anything
+static std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int) (unsigned char) c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+// a field quoted for csv when it has to be, rfc 4180 style with quotes doubled
+static std::string csvField(const std::string& text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        return text;
+    }
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') {
+            quoted += '"';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// csv, or json if the name ends in .json, like the frame profiler
+// a csv has one table per file, so latencies go next to it in name_latency.csv
+static bool writeLatencyCsv(const std::string& path, const std::vector<LatencyResult>& latencies)
+{
+    std::string stem = path;
+    if (stem.size() >= 4 && stem.compare(stem.size() - 4, 4, ".csv") == 0) {
+        stem.resize(stem.size() - 4);
+    }
+    std::FILE* out = std::fopen((stem + "_latency.csv").c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    std::fprintf(out, "kernel,input,count,p50_ns,p99_ns,p999_ns,max_ns,cores,mean_queued,max_queued\n");
+    for (const LatencyResult& r : latencies) {
+        std::fprintf(out, "%s,%s,%zu,%.0f,%.0f,%.0f,%.0f,%u,%.2f,%zu\n", csvField(r.kernel).c_str(),
+                     csvField(r.input).c_str(), r.count, r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns,
+                     r.cores, r.mean_queued, r.max_queued);
+    }
+    bool ok = !std::ferror(out);
+    return (std::fclose(out) == 0) && ok;
+}
+
+static bool writeResults(const std::string& path, const std::vector<BenchResult>& results,
+                         const std::vector<LatencyResult>& latencies)
+{
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json) {
+        std::fprintf(out, "{\n  \"decimate_kernel\": %s,\n  \"results\": [", jsonString(decimateKernelName()).c_str());
+    } else {
+        std::fprintf(out, "kernel,input,channels,samples,bytes,seconds,ns_per_sample,mb_per_s\n");
+    }
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        double ns = r.samples ? r.seconds * 1e9 / (double) r.samples : 0.0;
+        double mbs = r.seconds > 0.0 ? (double) r.bytes / r.seconds / 1e6 : 0.0;
+        if (json) {
+            std::fprintf(out, "%s\n    {\"kernel\": %s, \"input\": %s, \"channels\": %u, \"samples\": %zu, "
+                         "\"bytes\": %zu, \"seconds\": %.9f, \"ns_per_sample\": %.4f, \"mb_per_s\": %.2f}",
+                         i ? "," : "", jsonString(r.kernel).c_str(), jsonString(r.input).c_str(), r.channels, r.samples, r.bytes,
+                         r.seconds, ns, mbs);
+        } else {
+            std::fprintf(out, "%s,%s,%u,%zu,%zu,%.9f,%.4f,%.2f\n", csvField(r.kernel).c_str(), csvField(r.input).c_str(), r.channels,
+                         r.samples, r.bytes, r.seconds, ns, mbs);
+        }
+    }
+    if (json) {
+        std::fprintf(out, "\n  ],\n  \"latency\": [");
+        for (std::size_t i = 0; i < latencies.size(); i++) {
+            const LatencyResult& r = latencies[i];
+            std::fprintf(out, "%s\n    {\"kernel\": %s, \"input\": %s, \"count\": %zu, \"p50_ns\": %.0f, "
+                         "\"p99_ns\": %.0f, \"p999_ns\": %.0f, \"max_ns\": %.0f, \"cores\": %u, "
+                         "\"mean_queued\": %.2f, \"max_queued\": %zu}",
+                         i ? "," : "", jsonString(r.kernel).c_str(), jsonString(r.input).c_str(), r.count,
+                         r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns, r.cores, r.mean_queued, r.max_queued);
+        }
+        std::fprintf(out, "\n  ]\n}\n");
+    }
+    bool ok = !std::ferror(out);
+    ok = (std::fclose(out) == 0) && ok;
+    return json ? ok : ok && writeLatencyCsv(path, latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string out_path;
+    std::string audio_file;
+    int repeat = 5;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--ring-stress") == 0) {
+            return stressRing() ? 0 : 1;
+        } else if (argv[i][0] == '-') {
+            printf("usage: %s [--out results.csv|results.json] [--repeat N] [--ring-stress] [audio_file]\n", argv[0]);
+            return -1;
+        } else {
+            audio_file = argv[i];
+        }
+    }
+    printf("decimating with %s kernel, best of %d runs\n", decimateKernelName(), repeat);
+
+    std::vector<BenchResult> results;
+    const double lengths[] = {1.0, 10.0, 120.0}; // seconds
+    const unsigned int channel_counts[] = {1, 2, 6};
+    std::vector<sf::Int16> pcm;
+    for (double seconds : lengths) {
+        for (unsigned int channels : channel_counts) {
+            synthesize(pcm, (std::size_t) (seconds * sample_rate), channels);
+            char input[32];
+            std::snprintf(input, sizeof(input), "synthetic %gs", seconds);
+            benchPcm(pcm, channels, sample_rate, input, repeat, results);
+        }
+    }
+
+    if (!audio_file.empty()) {
+        unsigned int channels = 0, rate = 0;
+        if (!benchDecode(audio_file, repeat, results, pcm, channels, rate)) {
+            printf("Failed to open audio file\n");
+            return -1;
+        }
+        benchPcm(pcm, channels, rate, audio_file, repeat, results);
+    }
+
+    benchRingThroughput(repeat, results);
+    std::vector<LatencyResult> latencies;
+    benchRingLatency(latencies);
+
+    printTable(results);
+    printLatencyTable(latencies);
+    if (!out_path.empty() && !writeResults(out_path, results, latencies)) {
+        printf("Failed to write %s\n", out_path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// g++ -O2 bench.cpp audio_stream.cpp decimate.cpp normalizer.cpp spectrum.cpp -lsfml-audio -lsfml-system -o bench
+// ./bench --out bench.json c418_sweden.flac, with --out bench.csv latencies go to bench_latency.csv
+// ./bench --ring-stress exits non zero if the ring ever loses, repeats or reorders an item
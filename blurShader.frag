@@ -0,0 +1,21 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D source;
+uniform vec2 axis; // (1, 0) blurs across, (0, 1) down
+
+void main()
+{
+    vec2 direction = axis / vec2(textureSize(source, 0));
+
+    // 9 tap gaussian, run once across and once down
+    const float weights[5] = float[](0.2270270, 0.1945946, 0.1216216, 0.0540540, 0.0162162);
+    vec3 sum = texture(source, uv).rgb * weights[0];
+    for (int i = 1; i < 5; i++) {
+        sum += texture(source, uv + direction * i).rgb * weights[i];
+        sum += texture(source, uv - direction * i).rgb * weights[i];
+    }
+    FragColor = vec4(sum, 1.0f);
+}
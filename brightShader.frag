@@ -0,0 +1,14 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D source;
+
+void main()
+{
+    // keep only what is bright enough to glow
+    vec3 colour = texture(source, uv).rgb;
+    float brightness = dot(colour, vec3(0.2126, 0.7152, 0.0722));
+    FragColor = vec4(colour * smoothstep(0.5, 0.9, brightness), 1.0f);
+}
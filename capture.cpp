@@ -0,0 +1,166 @@
+#include "capture.h"
+#include "decimate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+double captureClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CaptureBuffer::configure(unsigned int sample_rate, unsigned int channel_count)
+{
+    this->sample_rate = sample_rate;
+    this->channel_count = channel_count;
+}
+
+void CaptureBuffer::push(const sf::Int16* samples, std::size_t count)
+{
+    // whole frames only, so the consumer never sees the channels shift
+    std::size_t room = ring.writable() / channel_count * channel_count;
+    std::size_t take = std::min(count / channel_count * channel_count, room);
+    ring.push(samples, take);
+    if (take < count) {
+        dropped.fetch_add(count - take, std::memory_order_relaxed);
+    }
+    last_arrival.store(captureClock(), std::memory_order_release);
+}
+
+DeviceRecorder::DeviceRecorder(CaptureBuffer& buffer) : buffer(buffer)
+{
+    // sfml defaults to 100 ms chunks, far too coarse for the visuals
+    setProcessingInterval(sf::milliseconds(10));
+}
+
+DeviceRecorder::~DeviceRecorder()
+{
+    // sfml wants derived recorders to stop before they are destroyed
+    stop();
+}
+
+bool DeviceRecorder::open(const std::string& device, unsigned int sample_rate, unsigned int channel_count)
+{
+    if (!sf::SoundRecorder::isAvailable()) {
+        std::cout << "No audio capture available on this system" << std::endl;
+        return false;
+    }
+    if (!device.empty() && !setDevice(device)) {
+        std::cout << "Failed to select capture device " << device << std::endl;
+        return false;
+    }
+    setChannelCount(channel_count);
+    buffer.configure(sample_rate, channel_count);
+    return start(sample_rate);
+}
+
+bool DeviceRecorder::onProcessSamples(const sf::Int16* samples, std::size_t count)
+{
+    buffer.push(samples, count);
+    return true;
+}
+
+bool FakeRecorder::start(const std::string& path)
+{
+    if (!stream.open(path)) {
+        return false;
+    }
+    buffer.configure(stream.getSampleRate(), stream.getChannelCount());
+    chunk_frames = std::max(1u, stream.getSampleRate() / 100);
+    chunk_seconds = (double) chunk_frames / stream.getSampleRate();
+    stopping = false;
+    worker = std::thread(&FakeRecorder::run, this);
+    return true;
+}
+
+void FakeRecorder::stop()
+{
+    stopping = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void FakeRecorder::run()
+{
+    unsigned int channels = stream.getChannelCount();
+    std::vector<sf::Int16> chunk(chunk_frames * channels);
+
+    // chunks are due at fixed points in time, so sleeping late never adds up,
+    // and the file loops so it behaves like an endless input
+    auto start = std::chrono::steady_clock::now();
+    sf::Uint64 offset = 0;
+    for (long long index = 1; !stopping; index++) {
+        std::this_thread::sleep_until(start + std::chrono::duration<double>(index * chunk_seconds));
+        std::size_t got = stream.read(offset, chunk.data(), chunk.size());
+        if (got < chunk.size()) {
+            std::memset(chunk.data() + got, 0, (chunk.size() - got) * sizeof(sf::Int16));
+            offset = 0;
+        } else {
+            offset += got;
+        }
+        buffer.push(chunk.data(), chunk.size());
+    }
+}
+
+LiveAnalyzer::LiveAnalyzer(CaptureBuffer& buffer, const SpectrumSettings& settings)
+    : buffer(buffer), analyzer(settings, buffer.getSampleRate())
+{
+    window_frames = std::max(1u, buffer.getSampleRate() / 100);
+    unsigned int channels = buffer.getChannelCount();
+    chunk.reserve(settings.fft_size * channels);
+    chunk.resize(settings.fft_size * channels);
+    chunk_mono.reserve(settings.fft_size);
+    chunk_mono.resize(settings.fft_size);
+    history.reserve(settings.fft_size);
+    history.resize(settings.fft_size);
+    std::fill(history.begin(), history.end(), 0.0f);
+}
+
+void LiveAnalyzer::consume()
+{
+    // stamp first, whatever we pop arrived no later than this
+    double arrival = buffer.getLastArrival();
+    unsigned int channels = buffer.getChannelCount();
+    std::size_t n = history.size();
+    consumed_arrival = 0.0;
+    for (;;) {
+        std::size_t frames = buffer.pop(chunk.data(), chunk.size()) / channels;
+        if (frames == 0) {
+            break;
+        }
+        mixToMono(chunk.data(), frames, channels, chunk_mono.data());
+
+        // slide the history along and put the new frames at the end
+        std::memmove(history.data(), history.data() + frames, (n - frames) * sizeof(float));
+        std::memcpy(history.data() + n - frames, chunk_mono.data(), frames * sizeof(float));
+        pending_frames += frames;
+        consumed_arrival = arrival;
+    }
+}
+
+EnvelopeValue LiveAnalyzer::getLevel() const
+{
+    std::size_t n = history.size();
+    std::size_t count = std::min(window_frames, n);
+    float peak = 0.0f;
+    double energy = 0.0;
+    for (std::size_t i = n - count; i < n; i++) {
+        peak = std::max(peak, std::fabs(history[i]));
+        energy += (double) history[i] * history[i];
+    }
+    return {std::min(peak, 1.0f), (float) std::sqrt(energy / (double) count)};
+}
+
+bool LiveAnalyzer::update(double)
+{
+    if (pending_frames < analyzer.getSettings().hop) {
+        return false;
+    }
+    pending_frames = 0;
+    analyzer.analyze(history.data());
+    return true;
+}
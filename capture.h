@@ -0,0 +1,128 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "envelope.h"
+#include "spectrum.h"
+#include "spsc_ring.h"
+
+#include <SFML/Audio.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+// captured samples on their way from the recording thread to the render thread,
+// with the arrival time of the newest ones for measuring latency
+class CaptureBuffer
+{
+public:
+    // capacity in interleaved samples, anything beyond it is dropped
+    explicit CaptureBuffer(std::size_t capacity) : ring(capacity) {}
+
+    // set by whoever produces the samples, before they start
+    void configure(unsigned int sample_rate, unsigned int channel_count);
+    unsigned int getSampleRate() const { return sample_rate; }
+    unsigned int getChannelCount() const { return channel_count; }
+
+    // producer side, called on the recording thread
+    void push(const sf::Int16* samples, std::size_t count);
+
+    // consumer side, returns how many samples were copied out
+    std::size_t pop(sf::Int16* out, std::size_t count) { return ring.pop(out, count); }
+
+    // steady clock seconds when the newest samples came in
+    double getLastArrival() const { return last_arrival.load(std::memory_order_acquire); }
+
+    unsigned long long getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    SpscRing<sf::Int16> ring;
+    unsigned int sample_rate = 0;
+    unsigned int channel_count = 0;
+    std::atomic<double> last_arrival{0.0};
+    std::atomic<unsigned long long> dropped{0};
+};
+
+// steady clock in seconds, the clock capture arrivals are stamped with
+double captureClock();
+
+// records from a real input device on sfml's thread
+class DeviceRecorder : public sf::SoundRecorder
+{
+public:
+    explicit DeviceRecorder(CaptureBuffer& buffer);
+    ~DeviceRecorder() override;
+
+    // empty device means the system default, false if it cannot be opened
+    bool open(const std::string& device, unsigned int sample_rate, unsigned int channel_count);
+
+    // length of the chunks we ask sfml for, the audio side of the latency
+    double getChunkSeconds() const { return 0.01; }
+
+protected:
+    bool onProcessSamples(const sf::Int16* samples, std::size_t count) override;
+
+private:
+    CaptureBuffer& buffer;
+};
+
+// stands in for a device by pushing a file into the buffer at real time pace,
+// in the same chunk sizes a recorder would, so capture works without hardware
+class FakeRecorder
+{
+public:
+    explicit FakeRecorder(CaptureBuffer& buffer) : buffer(buffer) {}
+    ~FakeRecorder() { stop(); }
+
+    bool start(const std::string& path);
+    void stop();
+
+    double getChunkSeconds() const { return chunk_seconds; }
+
+private:
+    void run();
+
+    CaptureBuffer& buffer;
+    AudioStream stream;
+    std::size_t chunk_frames = 0;
+    double chunk_seconds = 0.01;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+};
+
+// the level and spectrum of whatever was captured most recently
+class LiveAnalyzer : public SpectrumSource
+{
+public:
+    LiveAnalyzer(CaptureBuffer& buffer, const SpectrumSettings& settings);
+
+    // drain the buffer into the history, call once a frame before anything else
+    void consume();
+
+    // peak and rms of the newest 10 ms
+    EnvelopeValue getLevel() const;
+
+    // analyses the newest window once a hop of new audio has come in, the time is ignored
+    bool update(double seconds) override;
+
+    const float* getBands() const override { return analyzer.getBands(); }
+    std::size_t getBandCount() const override { return analyzer.getBandCount(); }
+
+    // arrival time of the newest samples the last consume picked up, 0 if it got none
+    double getConsumedArrival() const { return consumed_arrival; }
+
+private:
+    CaptureBuffer& buffer;
+    SpectrumAnalyzer analyzer;
+    std::size_t window_frames;
+    AnalysisBuffer<sf::Int16> chunk;
+    AnalysisBuffer<float> chunk_mono;
+    AnalysisBuffer<float> history; // newest fft_size mono frames, oldest first
+    std::size_t pending_frames = 0; // arrived since the last analysis
+    double consumed_arrival = 0.0;
+};
+
+#endif
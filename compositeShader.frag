@@ -0,0 +1,12 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D base;
+uniform sampler2D glow;
+
+void main()
+{
+    FragColor = vec4(texture(base, uv).rgb + texture(glow, uv).rgb, 1.0f);
+}
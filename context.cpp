@@ -0,0 +1,205 @@
+#include "context.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef VISUALS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+bool GLContext::initGlfw(bool visible)
+{
+    if (!glfwInit()) {
+        return false;
+    }
+    glfw_ready = true;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
+// macos specific config
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    return true;
+}
+
+bool GLContext::loadGL(GLADloadproc loader)
+{
+    // init glad to load opengl func ptr addresses
+    if (!gladLoadGLLoader(loader)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool GLContext::createWindow(const char* title)
+{
+    if (!initGlfw(true)) {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+
+    // get the desktop resolution, there is none on a headless box
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = (monitor != NULL) ? glfwGetVideoMode(monitor) : NULL;
+    if (mode == NULL) {
+        std::cout << "No monitor found, try --headless" << std::endl;
+        destroy();
+        return false;
+    }
+    width = mode->width;
+    height = mode->height;
+
+    // create the glfw window
+    window = glfwCreateWindow(width, height, title, NULL, NULL);
+    if (window == NULL) {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        destroy();
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    return loadGL((GLADloadproc) glfwGetProcAddress);
+}
+
+bool GLContext::createHeadless(int width, int height)
+{
+    headless = true;
+    this->width = width;
+    this->height = height;
+
+    // a hidden window still needs a display server, but works with any driver
+    if (initGlfw(false)) {
+        window = glfwCreateWindow(width, height, "visuals", NULL, NULL);
+        if (window != NULL) {
+            glfwMakeContextCurrent(window);
+            return loadGL((GLADloadproc) glfwGetProcAddress);
+        }
+        glfwTerminate();
+        glfw_ready = false;
+    }
+
+#ifdef VISUALS_EGL
+    if (createEgl()) {
+        return loadGL((GLADloadproc) eglGetProcAddress);
+    }
+    std::cout << "Failed to create a headless GLFW or EGL context" << std::endl;
+#else
+    std::cout << "Failed to create a hidden GLFW window, build with -DVISUALS_EGL for surfaceless rendering" << std::endl;
+#endif
+    return false;
+}
+
+#ifdef VISUALS_EGL
+bool GLContext::createEgl()
+{
+    // mesa can give us a display with no window system at all
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &config_count) || config_count == 0) {
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        return false;
+    }
+
+    // no surface, everything is drawn into fbos
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return false;
+    }
+    egl_display = display;
+    egl_context = context;
+    return true;
+}
+#endif
+
+void GLContext::destroy()
+{
+#ifdef VISUALS_EGL
+    if (egl_context != nullptr) {
+        eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(egl_display, egl_context);
+        eglTerminate(egl_display);
+        egl_context = nullptr;
+        egl_display = nullptr;
+    }
+#endif
+    if (glfw_ready) {
+        glfwTerminate();
+        glfw_ready = false;
+    }
+    window = nullptr;
+}
+
+double GLContext::getTime() const
+{
+    if (glfw_ready) {
+        return glfwGetTime();
+    }
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool GLContext::shouldClose() const
+{
+    return close_requested || (window != nullptr && glfwWindowShouldClose(window));
+}
+
+void GLContext::requestClose()
+{
+    close_requested = true;
+    if (window != nullptr) {
+        glfwSetWindowShouldClose(window, true);
+    }
+}
+
+void GLContext::pollEvents()
+{
+    if (!headless) {
+        glfwPollEvents();
+    }
+}
+
+void GLContext::present()
+{
+    if (!headless) {
+        glfwSwapBuffers(window);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// owns the opengl 4.6 core context, either on a visible desktop sized window
+// or headless, where nothing is shown and rendering goes into an fbo
+class GLContext
+{
+public:
+    GLContext() {}
+    ~GLContext() { destroy(); }
+
+    GLContext(const GLContext&) = delete;
+    GLContext& operator=(const GLContext&) = delete;
+
+    // visible window the size of the primary monitor
+    bool createWindow(const char* title);
+
+    // invisible context, a hidden glfw window if there is a display and
+    // an egl surfaceless context otherwise (when built with VISUALS_EGL)
+    bool createHeadless(int width, int height);
+
+    void destroy();
+
+    bool isHeadless() const { return headless; }
+
+    // null for egl contexts
+    GLFWwindow* getWindow() const { return window; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // seconds since some fixed point, works without glfw too
+    double getTime() const;
+
+    bool shouldClose() const;
+    void requestClose();
+
+    // events and buffer swaps, both do nothing when headless
+    void pollEvents();
+    void present();
+
+private:
+    bool initGlfw(bool visible);
+    bool loadGL(GLADloadproc loader);
+#ifdef VISUALS_EGL
+    bool createEgl();
+#endif
+
+    GLFWwindow* window = nullptr;
+    bool glfw_ready = false;
+    bool headless = false;
+    bool close_requested = false;
+    int width = 0;
+    int height = 0;
+#ifdef VISUALS_EGL
+    void* egl_display = nullptr;
+    void* egl_context = nullptr;
+#endif
+};
+
+#endif
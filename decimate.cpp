@@ -0,0 +1,205 @@
+#include "decimate.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VISUALS_SSE2
+#include <emmintrin.h>
+#endif
+
+// avx2 is dispatched at runtime on gcc and clang, otherwise only when compiled in
+#if defined(VISUALS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define VISUALS_AVX2_DISPATCH
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// a window reduced to its peak and sum of squares, all in mono units of [-1, 1]
+struct WindowStats
+{
+    float peak;
+    float sum_sq;
+};
+
+// plain c++ version, works for any channel count
+static WindowStats windowScalar(const sf::Int16* samples, std::size_t frames, unsigned int channels)
+{
+    const float scale = 1.0f / (32768.0f * (float) channels);
+    WindowStats stats = {0.0f, 0.0f};
+    for (std::size_t f = 0; f < frames; f++) {
+        int mix = 0;
+        for (unsigned int c = 0; c < channels; c++) {
+            mix += samples[f * channels + c];
+        }
+        float v = (float) mix * scale;
+        stats.peak = std::max(stats.peak, std::fabs(v));
+        stats.sum_sq += v * v;
+    }
+    return stats;
+}
+
+#ifdef VISUALS_SSE2
+static float horizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+static float horizontalSum(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+// mono and stereo only, 4 frames per step
+static WindowStats windowSse2(const sf::Int16* samples, std::size_t frames, unsigned int channels)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / (32768.0f * (float) channels));
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128 peak = _mm_setzero_ps();
+    __m128 sum_sq = _mm_setzero_ps();
+
+    std::size_t f = 0;
+    for (; f + 4 <= frames; f += 4) {
+        __m128i mix;
+        if (channels == 2) {
+            // madd against ones adds each left/right pair into one int32
+            __m128i lr = _mm_loadu_si128((const __m128i*) (samples + f * 2));
+            mix = _mm_madd_epi16(lr, ones);
+        } else {
+            __m128i m = _mm_loadl_epi64((const __m128i*) (samples + f));
+            mix = _mm_srai_epi32(_mm_unpacklo_epi16(m, m), 16);
+        }
+        __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(mix), scale);
+        peak = _mm_max_ps(peak, _mm_and_ps(v, abs_mask));
+        sum_sq = _mm_add_ps(sum_sq, _mm_mul_ps(v, v));
+    }
+
+    WindowStats tail = windowScalar(samples + f * channels, frames - f, channels);
+    WindowStats stats;
+    stats.peak = std::max(horizontalMax(peak), tail.peak);
+    stats.sum_sq = horizontalSum(sum_sq) + tail.sum_sq;
+    return stats;
+}
+#endif
+
+#if defined(VISUALS_AVX2_DISPATCH) || defined(__AVX2__)
+#ifdef VISUALS_AVX2_DISPATCH
+__attribute__((target("avx2")))
+#endif
+// mono and stereo only, 8 frames per step
+static WindowStats windowAvx2(const sf::Int16* samples, std::size_t frames, unsigned int channels)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / (32768.0f * (float) channels));
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256 peak = _mm256_setzero_ps();
+    __m256 sum_sq = _mm256_setzero_ps();
+
+    std::size_t f = 0;
+    for (; f + 8 <= frames; f += 8) {
+        __m256i mix;
+        if (channels == 2) {
+            __m256i lr = _mm256_loadu_si256((const __m256i*) (samples + f * 2));
+            mix = _mm256_madd_epi16(lr, ones);
+        } else {
+            mix = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) (samples + f)));
+        }
+        __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(mix), scale);
+        peak = _mm256_max_ps(peak, _mm256_and_ps(v, abs_mask));
+        sum_sq = _mm256_add_ps(sum_sq, _mm256_mul_ps(v, v));
+    }
+
+    // fold down to 128 bits and reuse the sse2 reductions
+    __m128 peak4 = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum_sq), _mm256_extractf128_ps(sum_sq, 1));
+
+    WindowStats tail = windowScalar(samples + f * channels, frames - f, channels);
+    WindowStats stats;
+    stats.peak = std::max(horizontalMax(peak4), tail.peak);
+    stats.sum_sq = horizontalSum(sum4) + tail.sum_sq;
+    return stats;
+}
+#endif
+
+typedef WindowStats (*WindowKernel)(const sf::Int16*, std::size_t, unsigned int);
+
+struct KernelChoice
+{
+    WindowKernel kernel;
+    const char* name;
+};
+
+// picked once, the first time anything asks
+static KernelChoice pickKernel()
+{
+#if defined(__AVX2__)
+    return {windowAvx2, "avx2"};
+#elif defined(VISUALS_AVX2_DISPATCH)
+    if (__builtin_cpu_supports("avx2")) {
+        return {windowAvx2, "avx2"};
+    }
+    return {windowSse2, "sse2"};
+#elif defined(VISUALS_SSE2)
+    return {windowSse2, "sse2"};
+#else
+    return {windowScalar, "scalar"};
+#endif
+}
+
+static const KernelChoice& kernelChoice()
+{
+    static const KernelChoice choice = pickKernel();
+    return choice;
+}
+
+std::size_t decimateEnvelope(const sf::Int16* samples, std::size_t frames, unsigned int channels,
+                             std::size_t window_frames, float* peak, float* rms)
+{
+    if (channels == 0 || window_frames == 0) {
+        return 0;
+    }
+
+    // the simd kernels only know how to mix mono and stereo
+    WindowKernel kernel = (channels <= 2) ? kernelChoice().kernel : windowScalar;
+
+    std::size_t windows = frames / window_frames;
+    for (std::size_t w = 0; w < windows; w++) {
+        WindowStats stats = kernel(samples + w * window_frames * channels, window_frames, channels);
+        peak[w] = std::min(stats.peak, 1.0f);
+        rms[w] = std::min(std::sqrt(stats.sum_sq / (float) window_frames), 1.0f);
+    }
+    return windows;
+}
+
+void mixToMono(const sf::Int16* samples, std::size_t frames, unsigned int channels, float* mono)
+{
+    const float scale = 1.0f / (32768.0f * (float) std::max(channels, 1u));
+    if (channels == 1) {
+        for (std::size_t f = 0; f < frames; f++) {
+            mono[f] = (float) samples[f] * scale;
+        }
+    } else if (channels == 2) {
+        for (std::size_t f = 0; f < frames; f++) {
+            mono[f] = (float) (samples[f * 2] + samples[f * 2 + 1]) * scale;
+        }
+    } else {
+        for (std::size_t f = 0; f < frames; f++) {
+            int mix = 0;
+            for (unsigned int c = 0; c < channels; c++) {
+                mix += samples[f * channels + c];
+            }
+            mono[f] = (float) mix * scale;
+        }
+    }
+}
+
+const char* decimateKernelName()
+{
+    return kernelChoice().name;
+}
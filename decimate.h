@@ -0,0 +1,21 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <SFML/Audio.hpp>
+
+#include <cstddef>
+
+// mix interleaved frames down to mono and reduce every window_frames frames to
+// one peak and one rms value, both normalised to [0, 1]
+// writes frames / window_frames values (a trailing partial window is dropped)
+// and returns how many were written
+std::size_t decimateEnvelope(const sf::Int16* samples, std::size_t frames, unsigned int channels,
+                             std::size_t window_frames, float* peak, float* rms);
+
+// mix interleaved frames down to mono floats in [-1, 1]
+void mixToMono(const sf::Int16* samples, std::size_t frames, unsigned int channels, float* mono);
+
+// name of the kernel picked for this cpu, handy for logging and benchmarks
+const char* decimateKernelName();
+
+#endif
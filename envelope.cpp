@@ -0,0 +1,51 @@
+#include "envelope.h"
+#include "decimate.h"
+
+#include <algorithm>
+#include <cmath>
+
+Envelope::Envelope(AudioStream& stream, std::size_t window_frames, std::size_t chunk_windows)
+    : stream(stream), channels(stream.getChannelCount()), window_frames(std::max<std::size_t>(window_frames, 1))
+{
+    window_count = (long long) (stream.getSampleCount() / std::max(channels, 1u) / this->window_frames);
+
+    // interpolation needs a window and its neighbour in the same chunk
+    chunk_windows = std::max<std::size_t>(chunk_windows, 2);
+    raw_samples.reserve(chunk_windows * this->window_frames * channels);
+    peak.reserve(chunk_windows);
+    rms.reserve(chunk_windows);
+}
+
+EnvelopeValue Envelope::sample(double position)
+{
+    EnvelopeValue value = {0.0f, 0.0f};
+    if (window_count == 0) {
+        return value;
+    }
+
+    position = std::min(std::max(position, 0.0), (double) (window_count - 1));
+    long long i = (long long) std::floor(position);
+    long long next = std::min(i + 1, window_count - 1);
+    float t = (float) (position - (double) i);
+
+    if (i < chunk_start || next >= chunk_start + (long long) rms.size()) {
+        fill(i);
+    }
+
+    std::size_t a = (std::size_t) (i - chunk_start);
+    std::size_t b = (std::size_t) (next - chunk_start);
+    value.peak = peak[a] + (peak[b] - peak[a]) * t;
+    value.rms = rms[a] + (rms[b] - rms[a]) * t;
+    return value;
+}
+
+void Envelope::fill(long long first)
+{
+    chunk_start = first;
+    raw_samples.resize(stream.read((sf::Uint64) first * window_frames * channels,
+                                   raw_samples.data(), raw_samples.capacity()));
+    std::size_t windows = decimateEnvelope(raw_samples.data(), raw_samples.size() / channels,
+                                           channels, window_frames, peak.data(), rms.data());
+    peak.resize(windows);
+    rms.resize(windows);
+}
@@ -0,0 +1,64 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+
+#include <cstddef>
+
+// one envelope value, both fields normalised to [0, 1]
+struct EnvelopeValue
+{
+    float peak;
+    float rms;
+};
+
+// anything that can answer "how loud is the track here"
+class EnvelopeSource
+{
+public:
+    virtual ~EnvelopeSource() {}
+
+    // number of whole windows in the track
+    virtual long long size() const = 0;
+
+    // envelope windows per second of audio
+    virtual double getRate() const = 0;
+
+    // value at a fractional window index, linearly interpolated between neighbours
+    // positions outside the track are clamped to its ends
+    virtual EnvelopeValue sample(double position) = 0;
+
+    // fractional window index for a time in seconds, each window describes its centre
+    double positionAt(double seconds) const { return seconds * getRate() - 0.5; }
+};
+
+// peak/rms envelope of a streamed track, decimated a chunk of windows at a time
+// and looked up at fractional positions so the visuals can follow real time
+class Envelope : public EnvelopeSource
+{
+public:
+    Envelope(AudioStream& stream, std::size_t window_frames, std::size_t chunk_windows = 64);
+
+    std::size_t getWindowFrames() const { return window_frames; }
+
+    long long size() const override { return window_count; }
+    double getRate() const override { return (double) stream.getSampleRate() / (double) window_frames; }
+    EnvelopeValue sample(double position) override;
+
+private:
+    // decimate the chunk of windows starting at first
+    void fill(long long first);
+
+    AudioStream& stream;
+    unsigned int channels;
+    std::size_t window_frames;
+    long long window_count;
+
+    AnalysisBuffer<sf::Int16> raw_samples;
+    AnalysisBuffer<float> peak;
+    AnalysisBuffer<float> rms;
+    long long chunk_start = 0;
+};
+
+#endif
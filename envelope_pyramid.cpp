@@ -0,0 +1,242 @@
+#include "envelope_pyramid.h"
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "decimate.h"
+#include "thread_pool.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+static sf::Int16 toSample(float value)
+{
+    return (sf::Int16) std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+EnvelopeBucket mergeBuckets(const EnvelopeBucket& a, const EnvelopeBucket& b)
+{
+    EnvelopeBucket merged;
+    merged.min = std::min(a.min, b.min);
+    merged.max = std::max(a.max, b.max);
+    double squares = (double) a.rms * a.rms + (double) b.rms * b.rms;
+    merged.rms = (sf::Int16) std::lround(std::sqrt(squares / 2.0));
+    return merged;
+}
+
+// level 0 for buckets [first, end), decoded by this task alone
+static bool buildBase(const std::string& audio_path, std::size_t base_frames, std::size_t first, std::size_t end,
+                      EnvelopeBucket* out, const std::atomic<bool>& cancelled)
+{
+    const std::size_t chunk_buckets = 64;
+    AudioStream stream(8192, 2);
+    if (!stream.open(audio_path)) {
+        return false;
+    }
+    unsigned int channels = stream.getChannelCount();
+    AnalysisBuffer<sf::Int16> raw_samples(chunk_buckets * base_frames * channels);
+    AnalysisBuffer<float> mono(chunk_buckets * base_frames);
+    mono.resize(mono.capacity());
+
+    for (std::size_t bucket = first; bucket < end; bucket += chunk_buckets) {
+        if (cancelled) {
+            return false;
+        }
+        std::size_t got = stream.read((sf::Uint64) bucket * base_frames * channels, raw_samples.data(), raw_samples.capacity());
+        std::size_t frames = got / channels;
+        mixToMono(raw_samples.data(), frames, channels, mono.data());
+
+        // the last bucket of the track may be short, it still gets summarised
+        std::size_t buckets = std::min((frames + base_frames - 1) / base_frames, end - bucket);
+        for (std::size_t b = 0; b < buckets; b++) {
+            const float* window = mono.data() + b * base_frames;
+            std::size_t count = std::min(base_frames, frames - b * base_frames);
+            float low = window[0], high = window[0];
+            double squares = 0.0;
+            for (std::size_t f = 0; f < count; f++) {
+                low = std::min(low, window[f]);
+                high = std::max(high, window[f]);
+                squares += (double) window[f] * window[f];
+            }
+            out[bucket - first + b] = {toSample(low), toSample(high), toSample((float) std::sqrt(squares / (double) count))};
+        }
+        // a short read means the file ended early, leave the rest silent
+        for (std::size_t b = buckets; b < std::min(chunk_buckets, end - bucket); b++) {
+            out[bucket - first + b] = {0, 0, 0};
+        }
+    }
+    return true;
+}
+
+bool EnvelopePyramid::build(const std::string& audio_path, std::size_t base_frames, ThreadPool& pool)
+{
+    levels.clear();
+    AudioStream probe;
+    if (!probe.open(audio_path)) {
+        return false;
+    }
+    this->base_frames = std::max<std::size_t>(base_frames, 1);
+    sample_rate = probe.getSampleRate();
+    frame_count = probe.getSampleCount() / probe.getChannelCount();
+    std::size_t bucket_count = (std::size_t) ((frame_count + this->base_frames - 1) / this->base_frames);
+    if (bucket_count == 0) {
+        return false;
+    }
+
+    // level 0 in ranges that each decode their own part of the file
+    const std::size_t range_buckets = 4096;
+    std::size_t range_count = (bucket_count + range_buckets - 1) / range_buckets;
+    levels.emplace_back(bucket_count);
+    std::atomic<bool> failed{false};
+    pool.parallelFor(range_count, [&](std::size_t i) {
+        std::size_t first = i * range_buckets;
+        std::size_t end = std::min(first + range_buckets, bucket_count);
+        if (!failed && !buildBase(audio_path, this->base_frames, first, end, levels[0].data() + first, cancelled)) {
+            failed = true;
+        }
+    });
+    if (failed) {
+        levels.clear();
+        return false;
+    }
+
+    // every level halves the one below, rounding down like gl mip sizes do;
+    // an odd bucket left over is folded into the last one so nothing is lost
+    const std::size_t block_buckets = 1 << 16;
+    while (levels.back().size() > 1 && !cancelled) {
+        const std::vector<EnvelopeBucket>& below = levels.back();
+        std::vector<EnvelopeBucket> level(below.size() / 2);
+        std::size_t block_count = (level.size() + block_buckets - 1) / block_buckets;
+        pool.parallelFor(block_count, [&](std::size_t i) {
+            std::size_t end = std::min((i + 1) * block_buckets, level.size());
+            for (std::size_t b = i * block_buckets; b < end; b++) {
+                level[b] = mergeBuckets(below[b * 2], below[b * 2 + 1]);
+            }
+        });
+        if (below.size() % 2 != 0) {
+            EnvelopeBucket& last = level.back();
+            const EnvelopeBucket& odd = below.back();
+            last.min = std::min(last.min, odd.min);
+            last.max = std::max(last.max, odd.max);
+            // the last bucket already stands for two below, the odd one makes three
+            double squares = 2.0 * last.rms * last.rms + (double) odd.rms * odd.rms;
+            last.rms = (sf::Int16) std::lround(std::sqrt(squares / 3.0));
+        }
+        levels.push_back(std::move(level));
+    }
+    if (cancelled) {
+        levels.clear();
+        return false;
+    }
+    return true;
+}
+
+void EnvelopePyramid::start(const std::string& audio_path, std::size_t base_frames)
+{
+    cancel();
+    cancelled = false;
+    ready = false;
+    worker = std::thread([this, audio_path, base_frames]() {
+        ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        if (build(audio_path, base_frames, pool)) {
+            ready.store(true, std::memory_order_release);
+        }
+    });
+}
+
+bool EnvelopePyramid::wait()
+{
+    if (worker.joinable()) {
+        worker.join();
+    }
+    return isReady();
+}
+
+void EnvelopePyramid::cancel()
+{
+    cancelled = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void EnvelopePyramid::summarize(std::uint64_t first_frame, std::uint64_t end_frame, std::size_t count, EnvelopeBucket* out) const
+{
+    if (levels.empty() || count == 0) {
+        return;
+    }
+    end_frame = std::max(end_frame, first_frame + 1);
+    std::uint64_t span = end_frame - first_frame;
+
+    // the coarsest level whose buckets are no wider than a column, so a column
+    // only ever merges two or three buckets
+    std::uint64_t column_frames = std::max<std::uint64_t>(span / count, 1);
+    std::size_t level = 0;
+    while (level + 1 < levels.size() && getBucketFrames(level + 1) <= column_frames) {
+        level++;
+    }
+    const std::vector<EnvelopeBucket>& buckets = levels[level];
+    std::uint64_t bucket_frames = getBucketFrames(level);
+
+    for (std::size_t c = 0; c < count; c++) {
+        std::uint64_t start = first_frame + span * c / count;
+        std::uint64_t stop = first_frame + span * (c + 1) / count;
+        std::size_t b0 = (std::size_t) std::min<std::uint64_t>(start / bucket_frames, buckets.size() - 1);
+        std::size_t b1 = (std::size_t) std::min<std::uint64_t>((stop + bucket_frames - 1) / bucket_frames, buckets.size());
+        b1 = std::max(b1, b0 + 1);
+        if (start >= frame_count) {
+            out[c] = {0, 0, 0}; // past the end of the track
+            continue;
+        }
+
+        EnvelopeBucket column = buckets[b0];
+        double squares = (double) column.rms * column.rms;
+        for (std::size_t b = b0 + 1; b < b1; b++) {
+            column.min = std::min(column.min, buckets[b].min);
+            column.max = std::max(column.max, buckets[b].max);
+            squares += (double) buckets[b].rms * buckets[b].rms;
+        }
+        column.rms = (sf::Int16) std::lround(std::sqrt(squares / (double) (b1 - b0)));
+        out[c] = column;
+    }
+}
+
+unsigned int EnvelopePyramid::upload()
+{
+    if (levels.empty()) {
+        return 0;
+    }
+    int max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    texture_first_level = 0;
+    while (texture_first_level + 1 < levels.size() && levels[texture_first_level].size() > (std::size_t) max_size) {
+        texture_first_level++;
+    }
+
+    unsigned int texture;
+    glCreateTextures(GL_TEXTURE_1D, 1, &texture);
+    int mip_count = (int) (levels.size() - texture_first_level);
+    glTextureStorage1D(texture, mip_count, GL_RGB16_SNORM, (int) levels[texture_first_level].size());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    for (int mip = 0; mip < mip_count; mip++) {
+        const std::vector<EnvelopeBucket>& level = levels[texture_first_level + mip];
+        glTextureSubImage1D(texture, mip, 0, (int) level.size(), GL_RGB, GL_SHORT, level.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // min and max do not blend, shaders pick a level and read whole buckets
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+std::size_t EnvelopePyramid::getByteCount() const
+{
+    std::size_t bytes = 0;
+    for (const std::vector<EnvelopeBucket>& level : levels) {
+        bytes += level.size() * sizeof(EnvelopeBucket);
+    }
+    return bytes;
+}
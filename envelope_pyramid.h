@@ -0,0 +1,90 @@
+#ifndef ENVELOPE_PYRAMID_H
+#define ENVELOPE_PYRAMID_H
+
+#include <SFML/Audio.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+// min, max and rms of the mono mix over a run of frames, in 16 bit sample units
+// so a level costs 6 bytes per bucket
+struct EnvelopeBucket
+{
+    sf::Int16 min;
+    sf::Int16 max;
+    sf::Int16 rms;
+};
+
+// min/max/rms summaries of a whole track at power of two decimations, level 0
+// has base_frames frames per bucket and every level above halves the count
+// lets a waveform view draw any range at any zoom from about one bucket per
+// pixel instead of touching every sample
+class EnvelopePyramid
+{
+public:
+    EnvelopePyramid() {}
+    ~EnvelopePyramid() { cancel(); }
+
+    EnvelopePyramid(const EnvelopePyramid&) = delete;
+    EnvelopePyramid& operator=(const EnvelopePyramid&) = delete;
+
+    // decodes the file in ranges across pool and builds every level, each one
+    // merged from the one below in parallel too
+    bool build(const std::string& audio_path, std::size_t base_frames, ThreadPool& pool);
+
+    // build on a thread of its own with a pool that leaves a core for the render
+    // loop, nothing else may be called until isReady() says it is done
+    void start(const std::string& audio_path, std::size_t base_frames);
+    bool isReady() const { return ready.load(std::memory_order_acquire); }
+
+    // block until a started build is done, true if it worked
+    bool wait();
+
+    // stop a started build early, the pyramid is left empty
+    void cancel();
+
+    std::size_t getLevelCount() const { return levels.size(); }
+    std::size_t getBucketCount(std::size_t level) const { return levels[level].size(); }
+    const EnvelopeBucket* getLevel(std::size_t level) const { return levels[level].data(); }
+
+    // frames summarised by one bucket of a level
+    std::uint64_t getBucketFrames(std::size_t level) const { return (std::uint64_t) base_frames << level; }
+    unsigned int getSampleRate() const { return sample_rate; }
+    std::uint64_t getFrameCount() const { return frame_count; }
+
+    // splits [first_frame, end_frame) into count columns and summarises each,
+    // reading from the coarsest level that still has a bucket per column;
+    // columns are rounded out to whole buckets, so min and max never miss a peak
+    void summarize(std::uint64_t first_frame, std::uint64_t end_frame, std::size_t count, EnvelopeBucket* out) const;
+
+    // every level as a mipmapped GL_RGB16_SNORM 1d texture, levels wider than
+    // the driver allows are left out, so texture level 0 is getTextureFirstLevel()
+    // returns 0 if there is nothing to upload
+    unsigned int upload();
+    std::size_t getTextureFirstLevel() const { return texture_first_level; }
+
+    // bytes held by every level together
+    std::size_t getByteCount() const;
+
+private:
+    std::vector<std::vector<EnvelopeBucket>> levels;
+    std::size_t base_frames = 0;
+    unsigned int sample_rate = 0;
+    std::uint64_t frame_count = 0;
+    std::size_t texture_first_level = 0;
+
+    std::thread worker;
+    std::atomic<bool> ready{false};
+    std::atomic<bool> cancelled{false};
+};
+
+// one bucket covering both, with equal weight
+EnvelopeBucket mergeBuckets(const EnvelopeBucket& a, const EnvelopeBucket& b);
+
+#endif
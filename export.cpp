@@ -0,0 +1,377 @@
+#include "export.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+bool parseExportFormat(const char* name, ExportFormat& format)
+{
+    if (std::strcmp(name, "raw") == 0) {
+        format = ExportFormat::Raw;
+    } else if (std::strcmp(name, "ppm") == 0) {
+        format = ExportFormat::PPM;
+    } else if (std::strcmp(name, "png") == 0) {
+        format = ExportFormat::PNG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char* formatExtension(ExportFormat format)
+{
+    switch (format) {
+    case ExportFormat::Raw: return "raw";
+    case ExportFormat::PPM: return "ppm";
+    case ExportFormat::PNG: return "png";
+    }
+    return "bin";
+}
+
+static void putBigEndian(std::vector<unsigned char>& out, std::uint32_t value)
+{
+    out.push_back((unsigned char) (value >> 24));
+    out.push_back((unsigned char) (value >> 16));
+    out.push_back((unsigned char) (value >> 8));
+    out.push_back((unsigned char) value);
+}
+
+// length, type, data and a crc over type and data
+static void putPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, std::size_t size)
+{
+    putBigEndian(out, (std::uint32_t) size);
+    std::size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    putBigEndian(out, (std::uint32_t) crc32(0, &out[start], (uInt) (size + 4)));
+}
+
+static void encodePng(int width, int height, const unsigned char* rgba, std::vector<unsigned char>& out)
+{
+    // rgb rows, each behind a "sub" filter byte which makes flat colour compress well
+    std::size_t stride = (std::size_t) width * 3 + 1;
+    std::vector<unsigned char> filtered(stride * height);
+    for (int y = 0; y < height; y++) {
+        const unsigned char* src = rgba + (std::size_t) (height - 1 - y) * width * 4;
+        unsigned char* row = &filtered[(std::size_t) y * stride];
+        row[0] = 1;
+        unsigned char prev[3] = {0, 0, 0};
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                unsigned char v = src[x * 4 + c];
+                row[1 + x * 3 + c] = (unsigned char) (v - prev[c]);
+                prev[c] = v;
+            }
+        }
+    }
+
+    uLongf compressed_size = compressBound((uLong) filtered.size());
+    std::vector<unsigned char> compressed(compressed_size);
+    compress2(compressed.data(), &compressed_size, filtered.data(), (uLong) filtered.size(), Z_DEFAULT_COMPRESSION);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, (std::uint32_t) width);
+    putBigEndian(header, (std::uint32_t) height);
+    header.push_back(8); // bit depth
+    header.push_back(2); // truecolour
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // not interlaced
+    putPngChunk(out, "IHDR", header.data(), header.size());
+    putPngChunk(out, "IDAT", compressed.data(), compressed_size);
+    putPngChunk(out, "IEND", NULL, 0);
+}
+
+void encodeFrame(ExportFormat format, int width, int height, const unsigned char* rgba,
+                 std::vector<unsigned char>& out)
+{
+    out.clear();
+    std::size_t row_bytes = (std::size_t) width * 4;
+
+    // gl hands rows over bottom first, every format here wants the top first
+    if (format == ExportFormat::Raw) {
+        out.resize(row_bytes * height);
+        for (int y = 0; y < height; y++) {
+            std::memcpy(&out[(std::size_t) y * row_bytes], rgba + (std::size_t) (height - 1 - y) * row_bytes, row_bytes);
+        }
+    } else if (format == ExportFormat::PPM) {
+        char header[64];
+        int header_size = std::snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+        out.resize((std::size_t) header_size + (std::size_t) width * height * 3);
+        std::memcpy(out.data(), header, (std::size_t) header_size);
+        unsigned char* dst = &out[(std::size_t) header_size];
+        for (int y = 0; y < height; y++) {
+            const unsigned char* src = rgba + (std::size_t) (height - 1 - y) * row_bytes;
+            for (int x = 0; x < width; x++) {
+                *dst++ = src[x * 4];
+                *dst++ = src[x * 4 + 1];
+                *dst++ = src[x * 4 + 2];
+            }
+        }
+    } else {
+        encodePng(width, height, rgba, out);
+    }
+}
+
+// the real stdout, once claimStdout has moved our own printing out of its way
+static std::FILE* claimed_stdout = nullptr;
+
+bool claimStdout()
+{
+    if (claimed_stdout != nullptr) {
+        return true;
+    }
+    std::fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    _dup2(_fileno(stderr), _fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    claimed_stdout = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    claimed_stdout = fdopen(fd, "wb");
+#endif
+    return claimed_stdout != nullptr;
+}
+
+bool FrameWriter::open(const ExportSettings& settings)
+{
+    close();
+    this->settings = settings;
+
+    if (settings.target == "-") {
+        // normally claimed right after the options were read, this is only a fallback
+        if (!claimStdout()) {
+            return false;
+        }
+        stream = claimed_stdout;
+        claimed_stdout = nullptr;
+        return true;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(settings.target, error);
+    if (error) {
+        std::cout << "Failed to create export directory " << settings.target << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FrameWriter::write(long long index, const std::vector<unsigned char>& bytes)
+{
+    if (stream != nullptr) {
+        return std::fwrite(bytes.data(), 1, bytes.size(), stream) == bytes.size();
+    }
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "frame_%06lld.%s", index, formatExtension(settings.format));
+    std::string path = (std::filesystem::path(settings.target) / name).string();
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Failed to write " << path << std::endl;
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+void FrameWriter::close()
+{
+    if (stream != nullptr) {
+        std::fclose(stream);
+        stream = nullptr;
+    }
+}
+
+bool EncodePipeline::open(const ExportSettings& settings, int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    format = settings.format;
+    if (!writer.open(settings)) {
+        return false;
+    }
+
+    // a couple of frames per worker keeps everyone busy without unbounded memory
+    pool = std::make_unique<ThreadPool>(settings.threads);
+    slots.resize(pool->size() * 2 + 2);
+    for (Slot& slot : slots) {
+        slot.pixels.resize((std::size_t) width * height * 4);
+        free_slots.push_back(&slot);
+    }
+    next_write = 0;
+    submitted = 0;
+    closing = false;
+    failed = false;
+    writer_thread = std::thread(&EncodePipeline::writeInOrder, this);
+    return true;
+}
+
+bool EncodePipeline::submit(long long index, const unsigned char* rgba)
+{
+    Slot* slot;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_free.wait(lock, [this] { return !free_slots.empty() || failed; });
+        if (failed) {
+            return false;
+        }
+        slot = free_slots.back();
+        free_slots.pop_back();
+        submitted++;
+    }
+    slot->index = index;
+    std::memcpy(slot->pixels.data(), rgba, slot->pixels.size());
+    pool->submit([this, slot] { encode(slot); });
+    return true;
+}
+
+void EncodePipeline::encode(Slot* slot)
+{
+    encodeFrame(format, width, height, slot->pixels.data(), slot->encoded);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        encoded[slot->index] = slot;
+    }
+    frame_encoded.notify_one();
+}
+
+void EncodePipeline::writeInOrder()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        frame_encoded.wait(lock, [this] {
+            return encoded.count(next_write) > 0 || (closing && next_write >= submitted);
+        });
+        auto found = encoded.find(next_write);
+        if (found == encoded.end()) {
+            return; // closing and everything is written
+        }
+        Slot* slot = found->second;
+        encoded.erase(found);
+
+        // disk io happens outside the lock so encoders can keep finishing frames
+        lock.unlock();
+        bool ok = failed || writer.write(slot->index, slot->encoded);
+        lock.lock();
+
+        if (!ok) {
+            failed = true;
+        }
+        free_slots.push_back(slot);
+        next_write++;
+        slot_free.notify_one();
+    }
+}
+
+bool EncodePipeline::finish()
+{
+    if (!writer_thread.joinable()) {
+        return !failed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    frame_encoded.notify_one();
+    writer_thread.join();
+    pool.reset();
+    writer.close();
+    return !failed;
+}
+
+Exporter::~Exporter()
+{
+    for (std::size_t i = 0; i < ring_size; i++) {
+        if (fences[i] != nullptr) {
+            glDeleteSync(fences[i]);
+        }
+    }
+    if (pbos[0] != 0) {
+        glDeleteBuffers((int) ring_size, pbos);
+    }
+}
+
+bool Exporter::open(const ExportSettings& settings, int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    if (!pipeline.open(settings, width, height)) {
+        return false;
+    }
+
+    // one buffer per frame in flight, written by the gpu and mapped by us later
+    glGenBuffers((int) ring_size, pbos);
+    for (std::size_t i = 0; i < ring_size; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+bool Exporter::capture(unsigned int fbo)
+{
+    // the slot we are about to reuse holds the oldest frame, it has had
+    // ring_size - 1 frames to land
+    std::size_t slot = (std::size_t) (captured % (long long) ring_size);
+    bool ok = collect(slot);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*) 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot_frame[slot] = captured;
+    captured++;
+    return ok;
+}
+
+bool Exporter::collect(std::size_t slot)
+{
+    if (fences[slot] == nullptr) {
+        return true;
+    }
+
+    // normally already signalled, this only blocks when the gpu is far behind
+    glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fences[slot]);
+    fences[slot] = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+    const unsigned char* pixels = (const unsigned char*) glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) width * height * 4, GL_MAP_READ_BIT);
+    bool ok = pixels != nullptr;
+    if (ok) {
+        ok = pipeline.submit(slot_frame[slot], pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return ok;
+}
+
+bool Exporter::finish()
+{
+    // oldest first so a stream stays in order
+    bool ok = true;
+    for (std::size_t i = 0; i < ring_size; i++) {
+        ok = collect((std::size_t) ((captured + (long long) i) % (long long) ring_size)) && ok;
+    }
+    return pipeline.finish() && ok;
+}
@@ -0,0 +1,142 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <glad/glad.h>
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ExportFormat
+{
+    Raw, // rgba8 frames back to back, top row first
+    PPM,
+    PNG
+};
+
+struct ExportSettings
+{
+    std::string target; // directory for an image sequence, "-" for stdout
+    ExportFormat format = ExportFormat::PPM;
+    int fps = 60;
+    unsigned int threads = 0; // encoder threads, 0 is one per core
+};
+
+bool parseExportFormat(const char* name, ExportFormat& format);
+
+// turn one bottom-up rgba8 frame as read from gl into the bytes of one output file
+void encodeFrame(ExportFormat format, int width, int height, const unsigned char* rgba,
+                 std::vector<unsigned char>& out);
+
+// frames going to stdout own it from here on: everything printed afterwards
+// goes to stderr instead, so call this before the first printf of the run
+// false if stdout could not be duplicated
+bool claimStdout();
+
+// puts encoded frames where they belong, numbered files or one stream on stdout
+class FrameWriter
+{
+public:
+    ~FrameWriter() { close(); }
+
+    bool open(const ExportSettings& settings);
+    bool write(long long index, const std::vector<unsigned char>& bytes);
+    void close();
+
+private:
+    ExportSettings settings;
+    std::FILE* stream = nullptr;
+};
+
+// encodes frames on a pool of workers and commits them in order on a writer
+// thread, so the render thread only ever pays for one memcpy per frame
+class EncodePipeline
+{
+public:
+    EncodePipeline() {}
+    ~EncodePipeline() { finish(); }
+
+    bool open(const ExportSettings& settings, int width, int height);
+
+    // copy a bottom-up rgba8 frame in and queue it, only blocks when every
+    // slot is still being encoded or waiting to be written
+    bool submit(long long index, const unsigned char* rgba);
+
+    // wait for everything queued to be written
+    bool finish();
+
+private:
+    // one frame on its way through, raw pixels in and file bytes out
+    struct Slot
+    {
+        long long index;
+        std::vector<unsigned char> pixels;
+        std::vector<unsigned char> encoded;
+    };
+
+    void encode(Slot* slot);
+    void writeInOrder();
+
+    int width = 0;
+    int height = 0;
+    ExportFormat format = ExportFormat::PPM;
+    FrameWriter writer;
+
+    std::vector<Slot> slots;
+    std::vector<Slot*> free_slots;
+    std::map<long long, Slot*> encoded; // finished frames waiting for their turn
+    long long next_write = 0;
+    long long submitted = 0;
+    bool closing = false;
+    std::mutex mutex;
+    std::condition_variable slot_free;
+    std::condition_variable frame_encoded;
+
+    std::unique_ptr<ThreadPool> pool;
+    std::thread writer_thread;
+    std::atomic<bool> failed{false};
+};
+
+// reads finished frames back from the gpu through a ring of pixel pack buffers,
+// so glReadPixels returns at once and the copy lands a few frames later
+class Exporter
+{
+public:
+    ~Exporter();
+
+    bool open(const ExportSettings& settings, int width, int height);
+
+    // queue a readback of the given fbo, and pass whichever older frame has landed on to the encoders
+    bool capture(unsigned int fbo);
+
+    // wait for the frames still in flight and write them
+    bool finish();
+
+    long long getFrameCount() const { return captured; }
+
+private:
+    bool collect(std::size_t slot);
+
+    static const std::size_t ring_size = 3;
+
+    int width = 0;
+    int height = 0;
+    unsigned int pbos[ring_size] = {0, 0, 0};
+    GLsync fences[ring_size] = {nullptr, nullptr, nullptr};
+    long long slot_frame[ring_size] = {-1, -1, -1};
+    long long captured = 0;
+
+    EncodePipeline pipeline;
+};
+
+#endif
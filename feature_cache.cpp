@@ -0,0 +1,422 @@
+#include "feature_cache.h"
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "decimate.h"
+#include "hash.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char feature_magic[8] = {'V', 'F', 'E', 'A', 'T', 0, 0, 0};
+static const std::uint32_t feature_version = 1;
+
+std::uint64_t featureKey(const std::string& audio_path, const FeatureParams& params)
+{
+    std::uint64_t hash = fnv_offset;
+    hash = hashValue(hash, feature_version);
+
+    std::error_code error;
+    std::uint64_t size = (std::uint64_t) std::filesystem::file_size(audio_path, error);
+    hash = hashValue(hash, size);
+    auto mtime = std::filesystem::last_write_time(audio_path, error);
+    hash = hashValue(hash, (long long) mtime.time_since_epoch().count());
+
+    // the head and tail catch re-encodes that keep the size
+    const std::size_t probe = 64 * 1024;
+    std::vector<char> buffer(probe);
+    std::ifstream file(audio_path, std::ios::binary);
+    file.read(buffer.data(), probe);
+    hash = hashBytes(hash, buffer.data(), (std::size_t) file.gcount());
+    if (size > probe) {
+        file.clear();
+        file.seekg((std::streamoff) (size - probe));
+        file.read(buffer.data(), probe);
+        hash = hashBytes(hash, buffer.data(), (std::size_t) file.gcount());
+    }
+
+    hash = hashValue(hash, (std::uint64_t) params.window_frames);
+    hash = hashValue(hash, params.spectra);
+    if (params.spectra) {
+        hash = hashValue(hash, (std::uint64_t) params.spectrum.fft_size);
+        hash = hashValue(hash, (std::uint64_t) params.spectrum.hop);
+        hash = hashValue(hash, (std::uint64_t) params.spectrum.bands);
+        hash = hashValue(hash, params.spectrum.min_freq);
+        hash = hashValue(hash, params.spectrum.smoothing);
+    }
+    return hash;
+}
+
+std::string featureCachePath(const std::string& audio_path)
+{
+    return audio_path + ".vfeat";
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+    void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    map_handle = map;
+    bytes = static_cast<const unsigned char*>(view);
+    length = (std::size_t) file_size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(NULL, (std::size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    bytes = static_cast<const unsigned char*>(view);
+    length = (std::size_t) info.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(map_handle);
+    CloseHandle(file_handle);
+#else
+    munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+}
+
+bool FeatureCache::open(const std::string& path, std::uint64_t key)
+{
+    if (!file.open(path)) {
+        return false;
+    }
+    if (file.size() < sizeof(FeatureHeader)) {
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(FeatureHeader));
+
+    std::uint64_t envelope_bytes = header.window_count * 2 * sizeof(std::uint16_t);
+    std::uint64_t spectrum_bytes = header.spectrum_count * header.spectrum_bands;
+    bool valid = std::memcmp(header.magic, feature_magic, sizeof(feature_magic)) == 0
+        && header.version == feature_version
+        && header.key == key
+        && header.sample_rate > 0
+        && header.window_frames > 0
+        && header.envelope_offset % alignof(std::uint16_t) == 0
+        && header.envelope_offset + envelope_bytes <= file.size()
+        && header.spectrum_offset + spectrum_bytes <= file.size();
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    envelope = reinterpret_cast<const std::uint16_t*>(file.data() + header.envelope_offset);
+    spectra = file.data() + header.spectrum_offset;
+    return true;
+}
+
+double CachedEnvelope::getRate() const
+{
+    const FeatureHeader& header = cache.getHeader();
+    return (double) header.sample_rate / (double) header.window_frames;
+}
+
+EnvelopeValue CachedEnvelope::sample(double position)
+{
+    EnvelopeValue value = {0.0f, 0.0f};
+    long long count = size();
+    if (count == 0) {
+        return value;
+    }
+
+    position = std::min(std::max(position, 0.0), (double) (count - 1));
+    long long i = (long long) std::floor(position);
+    long long next = std::min(i + 1, count - 1);
+    float t = (float) (position - (double) i);
+
+    const std::uint16_t* env = cache.getEnvelope();
+    const float scale = 1.0f / 65535.0f;
+    float peak_a = env[i * 2] * scale, peak_b = env[next * 2] * scale;
+    float rms_a = env[i * 2 + 1] * scale, rms_b = env[next * 2 + 1] * scale;
+    value.peak = peak_a + (peak_b - peak_a) * t;
+    value.rms = rms_a + (rms_b - rms_a) * t;
+    return value;
+}
+
+CachedSpectrum::CachedSpectrum(const FeatureCache& cache)
+    : cache(cache), bands(cache.getHeader().spectrum_bands, 0.0f)
+{
+}
+
+bool CachedSpectrum::update(double seconds)
+{
+    const FeatureHeader& header = cache.getHeader();
+    long long frame = (long long) std::llround(seconds * header.sample_rate / header.spectrum_hop);
+    frame = std::min(std::max(frame, 0ll), (long long) header.spectrum_count - 1);
+    if (frame == current) {
+        return false;
+    }
+    current = frame;
+
+    const std::uint8_t* levels = cache.getSpectra() + (std::size_t) frame * header.spectrum_bands;
+    for (std::size_t b = 0; b < bands.size(); b++) {
+        bands[b] = levels[b] * (1.0f / 255.0f);
+    }
+    return true;
+}
+
+FeatureCacheBuilder::~FeatureCacheBuilder()
+{
+    cancel();
+}
+
+void FeatureCacheBuilder::start(const std::string& audio_path, const std::string& cache_path,
+                                const FeatureParams& params, std::uint64_t key)
+{
+    cancel();
+    cancelled = false;
+    worker = std::thread(&FeatureCacheBuilder::run, this, audio_path, cache_path, params, key);
+}
+
+bool FeatureCacheBuilder::build(const std::string& audio_path, const std::string& cache_path,
+                                const FeatureParams& params, std::uint64_t key)
+{
+    cancel();
+    cancelled = false;
+    return run(audio_path, cache_path, params, key);
+}
+
+void FeatureCacheBuilder::cancel()
+{
+    cancelled = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+static std::uint16_t quantize16(float v)
+{
+    return (std::uint16_t) std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f);
+}
+
+static std::uint8_t quantize8(float v)
+{
+    return (std::uint8_t) std::lround(std::min(std::max(v, 0.0f), 1.0f) * 255.0f);
+}
+
+// everything one analysis task needs to know and where its results go
+struct FeatureRange
+{
+    std::uint64_t first_window;
+    std::uint64_t end_window;
+    std::uint64_t first_spectrum;
+    std::uint64_t end_spectrum;
+    float peak = 0.0f;
+    float rms_peak = 0.0f;
+};
+
+// decode one range of the track on its own stream and fill in its part of the cache
+// spectra come out unsmoothed, the smoothing carries state from one hop to the
+// next so it is applied afterwards in a single pass over the whole track
+static bool analyzeRange(const std::string& audio_path, const FeatureParams& params, const FeatureHeader& header,
+                         FeatureRange& range, std::uint16_t* envelope, float* levels,
+                         const std::atomic<bool>& cancelled)
+{
+    // the ring has to reach back over one envelope chunk plus half an fft so
+    // spectra never need a block decoded again
+    const std::size_t chunk_windows = 64;
+    AudioStream stream(8192, 8);
+    if (!stream.open(audio_path)) {
+        return false;
+    }
+    unsigned int channels = stream.getChannelCount();
+    std::size_t window_frames = params.window_frames;
+    std::uint64_t frame_count = stream.getSampleCount() / channels;
+
+    AnalysisBuffer<sf::Int16> raw_samples(chunk_windows * window_frames * channels);
+    AnalysisBuffer<float> peak(chunk_windows);
+    AnalysisBuffer<float> rms(chunk_windows);
+    SpectrumSettings raw_settings = params.spectrum;
+    raw_settings.smoothing = 0.0f;
+    Spectrum spectrum(stream, raw_settings);
+    std::uint64_t hop = params.spectrum.hop;
+    std::uint64_t next_spectrum = range.first_spectrum;
+
+    for (std::uint64_t first = range.first_window; first < range.end_window; first += chunk_windows) {
+        if (cancelled) {
+            return false;
+        }
+
+        std::size_t got = stream.read(first * window_frames * channels, raw_samples.data(), raw_samples.capacity());
+        std::size_t windows = decimateEnvelope(raw_samples.data(), got / channels, channels,
+                                               window_frames, peak.data(), rms.data());
+        windows = (std::size_t) std::min<std::uint64_t>(windows, range.end_window - first);
+        for (std::size_t w = 0; w < windows; w++) {
+            envelope[(first + w) * 2] = quantize16(peak[w]);
+            envelope[(first + w) * 2 + 1] = quantize16(rms[w]);
+            range.peak = std::max(range.peak, peak[w]);
+            range.rms_peak = std::max(range.rms_peak, rms[w]);
+        }
+
+        // spectra whose windows are fully decoded by now, while the blocks are still in the ring
+        std::uint64_t decoded = std::min((first + windows) * window_frames, frame_count);
+        bool last_chunk = first + chunk_windows >= range.end_window;
+        while (next_spectrum < range.end_spectrum
+               && (last_chunk || next_spectrum * hop + params.spectrum.fft_size / 2 <= decoded)) {
+            spectrum.analyzeFrame((long long) (next_spectrum * hop));
+            std::memcpy(levels + next_spectrum * header.spectrum_bands, spectrum.getBands(),
+                        header.spectrum_bands * sizeof(float));
+            next_spectrum++;
+        }
+    }
+    return true;
+}
+
+bool FeatureCacheBuilder::run(std::string audio_path, std::string cache_path, FeatureParams params, std::uint64_t key)
+{
+    AudioStream probe;
+    if (!probe.open(audio_path)) {
+        return false;
+    }
+    std::size_t window_frames = params.window_frames;
+    std::uint64_t frame_count = probe.getSampleCount() / probe.getChannelCount();
+
+    FeatureHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, feature_magic, sizeof(feature_magic));
+    header.version = feature_version;
+    header.sample_rate = probe.getSampleRate();
+    header.key = key;
+    header.window_frames = (std::uint32_t) window_frames;
+    header.window_count = frame_count / window_frames;
+    if (params.spectra) {
+        header.spectrum_bands = (std::uint32_t) params.spectrum.bands;
+        header.spectrum_hop = (std::uint32_t) params.spectrum.hop;
+        header.spectrum_fft_size = (std::uint32_t) params.spectrum.fft_size;
+        header.spectrum_count = frame_count / params.spectrum.hop + 1;
+    }
+    header.envelope_offset = sizeof(FeatureHeader);
+    header.spectrum_offset = header.envelope_offset + header.window_count * 2 * sizeof(std::uint16_t);
+
+    std::vector<std::uint16_t> envelope((std::size_t) header.window_count * 2);
+    std::vector<std::uint8_t> spectra((std::size_t) (header.spectrum_count * header.spectrum_bands));
+    std::vector<float> levels(spectra.size()); // unsmoothed, until the serial pass below
+
+    // split the track into ranges of about 40 s each, spectra go to the range holding their centre
+    const std::uint64_t range_windows = 4096;
+    std::vector<FeatureRange> ranges;
+    for (std::uint64_t first = 0; first < header.window_count; first += range_windows) {
+        FeatureRange range;
+        range.first_window = first;
+        range.end_window = std::min(first + range_windows, header.window_count);
+        if (params.spectra) {
+            std::uint64_t hop = params.spectrum.hop;
+            range.first_spectrum = (first * window_frames + hop - 1) / hop;
+            range.end_spectrum = (range.end_window == header.window_count) ? header.spectrum_count
+                : std::min((range.end_window * window_frames + hop - 1) / hop, header.spectrum_count);
+        } else {
+            range.first_spectrum = range.end_spectrum = 0;
+        }
+        ranges.push_back(range);
+    }
+
+    // every range decodes on its own, leave a core for the render loop
+    std::atomic<bool> failed{false};
+    {
+        ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        pool.parallelFor(ranges.size(), [&](std::size_t i) {
+            if (!failed && !analyzeRange(audio_path, params, header, ranges[i], envelope.data(), levels.data(), cancelled)) {
+                failed = true;
+            }
+        });
+    }
+    if (failed) {
+        return false;
+    }
+    // the smoothing runs over the whole track in order, exactly as a live Spectrum
+    // would, so the cache matches a serial analysis bit for bit
+    std::vector<float> bands(header.spectrum_bands, 0.0f);
+    for (std::uint64_t f = 0; f < header.spectrum_count; f++) {
+        const float* level = levels.data() + f * header.spectrum_bands;
+        std::uint8_t* out = spectra.data() + f * header.spectrum_bands;
+        for (std::size_t b = 0; b < header.spectrum_bands; b++) {
+            bands[b] = smoothBand(bands[b], level[b], params.spectrum.smoothing);
+            out[b] = quantize8(bands[b]);
+        }
+    }
+
+    for (const FeatureRange& range : ranges) {
+        header.peak = std::max(header.peak, range.peak);
+        header.rms_peak = std::max(header.rms_peak, range.rms_peak);
+    }
+
+    // write next to the target and rename, so a half written cache is never picked up
+    std::string temp_path = cache_path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(envelope.data()), (std::streamsize) (envelope.size() * sizeof(std::uint16_t)));
+        out.write(reinterpret_cast<const char*>(spectra.data()), (std::streamsize) spectra.size());
+        if (!out) {
+            printf("Failed to write feature cache %s\n", temp_path.c_str());
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, cache_path, error);
+    if (error) {
+        printf("Failed to write feature cache %s\n", cache_path.c_str());
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    printf("wrote feature cache %s\n", cache_path.c_str());
+    return true;
+}
@@ -0,0 +1,149 @@
+#ifndef FEATURE_CACHE_H
+#define FEATURE_CACHE_H
+
+#include "envelope.h"
+#include "spectrum.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// on disk layout of a .vfeat file, all little endian
+// the header is followed by window_count (peak, rms) uint16 pairs and then
+// spectrum_count frames of spectrum_bands uint8 levels
+struct FeatureHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t sample_rate;
+    std::uint64_t key; // source file and analysis parameters
+    std::uint32_t window_frames;
+    std::uint32_t spectrum_bands; // 0 when no spectra are stored
+    std::uint64_t window_count;
+    std::uint32_t spectrum_hop;
+    std::uint32_t spectrum_fft_size;
+    std::uint64_t spectrum_count;
+    float peak; // loudest window peak, for normalisation
+    float rms_peak; // loudest window rms
+    std::uint64_t envelope_offset;
+    std::uint64_t spectrum_offset;
+};
+
+// what the cached features were computed with, any change invalidates the cache
+struct FeatureParams
+{
+    std::size_t window_frames;
+    SpectrumSettings spectrum;
+    bool spectra;
+};
+
+// cheap identity of an audio file and the analysis parameters, it hashes the
+// size, modification time and the first and last 64 KiB rather than the whole file
+std::uint64_t featureKey(const std::string& audio_path, const FeatureParams& params);
+
+// default cache location, next to the audio file
+std::string featureCachePath(const std::string& audio_path);
+
+// read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* map_handle = nullptr;
+#endif
+};
+
+// a memory mapped .vfeat file
+class FeatureCache
+{
+public:
+    // fails if the file is missing, truncated or was made for a different key
+    bool open(const std::string& path, std::uint64_t key);
+
+    const FeatureHeader& getHeader() const { return header; }
+    bool hasSpectra() const { return header.spectrum_bands > 0 && header.spectrum_count > 0; }
+
+    const std::uint16_t* getEnvelope() const { return envelope; }
+    const std::uint8_t* getSpectra() const { return spectra; }
+
+private:
+    MappedFile file;
+    FeatureHeader header;
+    const std::uint16_t* envelope = nullptr;
+    const std::uint8_t* spectra = nullptr;
+};
+
+// envelope read straight out of a feature cache
+class CachedEnvelope : public EnvelopeSource
+{
+public:
+    explicit CachedEnvelope(const FeatureCache& cache) : cache(cache) {}
+
+    long long size() const override { return (long long) cache.getHeader().window_count; }
+    double getRate() const override;
+    EnvelopeValue sample(double position) override;
+
+private:
+    const FeatureCache& cache;
+};
+
+// spectra read straight out of a feature cache, one frame per hop
+class CachedSpectrum : public SpectrumSource
+{
+public:
+    explicit CachedSpectrum(const FeatureCache& cache);
+
+    bool update(double seconds) override;
+    const float* getBands() const override { return bands.data(); }
+    std::size_t getBandCount() const override { return bands.size(); }
+
+private:
+    const FeatureCache& cache;
+    std::vector<float> bands;
+    long long current = -1;
+};
+
+// analyses a whole track on a background thread and writes its feature cache,
+// so the next launch can skip decoding
+class FeatureCacheBuilder
+{
+public:
+    ~FeatureCacheBuilder();
+
+    void start(const std::string& audio_path, const std::string& cache_path,
+               const FeatureParams& params, std::uint64_t key);
+
+    // analyse and write the cache on the calling thread, true once it is on disk
+    bool build(const std::string& audio_path, const std::string& cache_path,
+               const FeatureParams& params, std::uint64_t key);
+
+    // stop early, nothing is written
+    void cancel();
+
+private:
+    bool run(std::string audio_path, std::string cache_path, FeatureParams params, std::uint64_t key);
+
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+};
+
+#endif
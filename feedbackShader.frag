@@ -0,0 +1,16 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D scene;
+uniform sampler2D previous;
+uniform float decay;
+
+void main()
+{
+    // last frame zoomed in slightly and faded, so shapes leave trails
+    vec2 zoomed = (uv - 0.5) * 0.99 + 0.5;
+    vec3 trail = texture(previous, zoomed).rgb * decay;
+    FragColor = vec4(max(texture(scene, uv).rgb, trail), 1.0f);
+}
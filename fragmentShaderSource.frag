@@ -1,7 +1,13 @@
 #version 460 core
 out vec4 FragColor;
 
+in float bandPos;
+in vec4 tint;
+
+uniform sampler1D spectrum;
+
 void main()
 {
-    FragColor = vec4(1.0f, 1.0f, 1.0f, 1.0f);
-} 
+    float level = texture(spectrum, bandPos).r;
+    FragColor = vec4(mix(vec3(0.1f, 0.2f, 0.8f), vec3(1.0f, 1.0f, 1.0f), level), 1.0f) * tint;
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <glad/glad.h>
+
+// an fbo with a single rgba8 colour texture
+class Framebuffer
+{
+public:
+    Framebuffer() {}
+    ~Framebuffer() { destroy(); }
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    bool create(int width, int height);
+    void destroy();
+
+    // bind for drawing and set the viewport to cover it
+    void bind() const;
+
+    unsigned int getId() const { return fbo; }
+    unsigned int getTexture() const { return texture; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    unsigned int fbo = 0;
+    unsigned int texture = 0;
+    int width = 0;
+    int height = 0;
+};
+
+#endif
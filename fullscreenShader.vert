@@ -0,0 +1,10 @@
+#version 460 core
+out vec2 uv;
+
+void main()
+{
+    // one triangle that covers the whole screen, no vertex buffer needed
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    uv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
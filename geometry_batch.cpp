@@ -0,0 +1,146 @@
+#include "geometry_batch.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+// every shape as plain triangles in one buffer, first vertex and count per shape
+const float shape_vertices[] = {
+    // triangle, the original one from the first visual
+    -0.5303f, -0.5303f,
+    0.5303f, -0.5303f,
+    0.0000f, 0.7500f,
+    // quad
+    -1.0f, -1.0f,
+    1.0f, -1.0f,
+    1.0f, 1.0f,
+    -1.0f, -1.0f,
+    1.0f, 1.0f,
+    -1.0f, 1.0f,
+};
+const unsigned int shape_first[] = {0, 3};
+const unsigned int shape_count_vertices[] = {3, 6};
+
+}
+
+bool GeometryBatch::create(std::size_t max_instances)
+{
+    destroy();
+    this->max_instances = max_instances;
+    if (!stream.create(max_instances * sizeof(Instance) + shape_count * sizeof(DrawCommand) + 256)) {
+        return false;
+    }
+
+    glCreateBuffers(1, &shape_buffer);
+    glNamedBufferStorage(shape_buffer, sizeof(shape_vertices), shape_vertices, 0);
+
+    // binding 0 walks the shape, binding 1 steps once per instance and is
+    // pointed at this frame's region of the stream buffer in draw
+    glCreateVertexArrays(1, &vao);
+    glVertexArrayVertexBuffer(vao, 0, shape_buffer, 0, 2 * sizeof(float));
+    glEnableVertexArrayAttrib(vao, 0);
+    glVertexArrayAttribFormat(vao, 0, 2, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(vao, 0, 0);
+
+    glVertexArrayBindingDivisor(vao, 1, 1);
+    glEnableVertexArrayAttrib(vao, 1);
+    glVertexArrayAttribFormat(vao, 1, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, x));
+    glVertexArrayAttribBinding(vao, 1, 1);
+    glEnableVertexArrayAttrib(vao, 2);
+    glVertexArrayAttribFormat(vao, 2, 1, GL_FLOAT, GL_FALSE, offsetof(Instance, rotation));
+    glVertexArrayAttribBinding(vao, 2, 1);
+    glEnableVertexArrayAttrib(vao, 3);
+    glVertexArrayAttribFormat(vao, 3, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, colour));
+    glVertexArrayAttribBinding(vao, 3, 1);
+
+    for (std::vector<Instance>& list : instances) {
+        list.reserve(max_instances);
+    }
+    return true;
+}
+
+void GeometryBatch::destroy()
+{
+    stream.destroy();
+    if (vao != 0) {
+        glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+    if (shape_buffer != 0) {
+        glDeleteBuffers(1, &shape_buffer);
+        shape_buffer = 0;
+    }
+}
+
+void GeometryBatch::clear()
+{
+    for (std::vector<Instance>& list : instances) {
+        list.clear();
+    }
+}
+
+void GeometryBatch::add(Shape shape, const Instance& instance)
+{
+    if (getInstanceCount() >= max_instances) {
+        return;
+    }
+    instances[(std::size_t) shape].push_back(instance);
+}
+
+void GeometryBatch::addLine(float x0, float y0, float x1, float y1, float thickness, const float colour[4])
+{
+    float dx = x1 - x0, dy = y1 - y0;
+    Instance line;
+    line.x = (x0 + x1) * 0.5f;
+    line.y = (y0 + y1) * 0.5f;
+    line.half_width = std::sqrt(dx * dx + dy * dy) * 0.5f;
+    line.half_height = thickness * 0.5f;
+    line.rotation = std::atan2(dy, dx);
+    std::memcpy(line.colour, colour, sizeof(line.colour));
+    add(Shape::Quad, line);
+}
+
+void GeometryBatch::draw(GLState& state)
+{
+    std::size_t total = getInstanceCount();
+    if (total == 0) {
+        return;
+    }
+
+    // instances grouped by shape, so each command covers one contiguous run
+    stream.beginFrame();
+    std::size_t instance_offset = 0, command_offset = 0;
+    Instance* out = (Instance*) stream.allocate(total * sizeof(Instance), instance_offset);
+    DrawCommand* commands = (DrawCommand*) stream.allocate(shape_count * sizeof(DrawCommand), command_offset, 16);
+    if (out == nullptr || commands == nullptr) {
+        return;
+    }
+    unsigned int base = 0;
+    for (std::size_t s = 0; s < shape_count; s++) {
+        std::memcpy(out + base, instances[s].data(), instances[s].size() * sizeof(Instance));
+        commands[s].count = shape_count_vertices[s];
+        commands[s].instance_count = (unsigned int) instances[s].size();
+        commands[s].first = shape_first[s];
+        commands[s].base_instance = base;
+        base += (unsigned int) instances[s].size();
+    }
+
+    glVertexArrayVertexBuffer(vao, 1, stream.getId(), (GLintptr) instance_offset, sizeof(Instance));
+    state.bindVertexArray(vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.getId());
+    glMultiDrawArraysIndirect(GL_TRIANGLES, (void*) command_offset, (int) shape_count, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    stream.endFrame();
+}
+
+std::size_t GeometryBatch::getInstanceCount() const
+{
+    std::size_t total = 0;
+    for (const std::vector<Instance>& list : instances) {
+        total += list.size();
+    }
+    return total;
+}
@@ -0,0 +1,77 @@
+#ifndef GEOMETRY_BATCH_H
+#define GEOMETRY_BATCH_H
+
+#include "gl_state.h"
+#include "stream_buffer.h"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// the unit shapes every primitive is an instance of
+enum class Shape
+{
+    Triangle,
+    Quad,
+};
+
+// one primitive, a unit shape scaled, rotated and moved into place
+struct Instance
+{
+    float x, y;
+    float half_width, half_height;
+    float rotation; // radians, counter clockwise
+    float colour[4];
+};
+
+// collects every primitive of a frame and draws them all with one
+// multi draw indirect call, one command per shape, so the number of draw
+// calls stays the same however many bars or particles a visual adds
+class GeometryBatch
+{
+public:
+    GeometryBatch() {}
+    ~GeometryBatch() { destroy(); }
+
+    GeometryBatch(const GeometryBatch&) = delete;
+    GeometryBatch& operator=(const GeometryBatch&) = delete;
+
+    // max_instances is the most a single frame will add
+    bool create(std::size_t max_instances);
+    void destroy();
+
+    // start collecting the next frame
+    void clear();
+
+    void add(Shape shape, const Instance& instance);
+
+    // a quad stretched between two points
+    void addLine(float x0, float y0, float x1, float y1, float thickness, const float colour[4]);
+
+    // draws everything added since clear with whatever program is bound,
+    // once per frame since the instances go through a stream buffer
+    void draw(GLState& state);
+
+    std::size_t getInstanceCount() const;
+
+private:
+    static const std::size_t shape_count = 2;
+
+    // the command layout glMultiDrawArraysIndirect reads
+    struct DrawCommand
+    {
+        unsigned int count;
+        unsigned int instance_count;
+        unsigned int first;
+        unsigned int base_instance;
+    };
+
+    std::size_t max_instances = 0;
+    std::vector<Instance> instances[shape_count];
+    StreamBuffer stream;
+    unsigned int shape_buffer = 0;
+    unsigned int vao = 0;
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// remembers what is bound so setting the same thing again costs nothing;
+// anything that binds behind its back has to call invalidate afterwards
+class GLState
+{
+public:
+    void useProgram(unsigned int program)
+    {
+        if (program != current_program) {
+            glUseProgram(program);
+            current_program = program;
+        }
+    }
+
+    void bindVertexArray(unsigned int vao)
+    {
+        if (vao != current_vao) {
+            glBindVertexArray(vao);
+            current_vao = vao;
+        }
+    }
+
+    // draw framebuffer only, the exporter reads on its own binding
+    void bindFramebuffer(unsigned int fbo)
+    {
+        if (fbo != current_fbo) {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+            current_fbo = fbo;
+        }
+    }
+
+    void viewport(int width, int height)
+    {
+        if (width != viewport_width || height != viewport_height) {
+            glViewport(0, 0, width, height);
+            viewport_width = width;
+            viewport_height = height;
+        }
+    }
+
+    void polygonMode(GLenum mode)
+    {
+        if (mode != polygon_mode) {
+            glPolygonMode(GL_FRONT_AND_BACK, mode);
+            polygon_mode = mode;
+        }
+    }
+
+    // binds to whichever target the texture was created for
+    void bindTexture(unsigned int unit, unsigned int texture)
+    {
+        if (unit >= unit_count) {
+            glBindTextureUnit(unit, texture);
+        } else if (texture != textures[unit]) {
+            glBindTextureUnit(unit, texture);
+            textures[unit] = texture;
+        }
+    }
+
+    // forget everything, the next call of each kind goes through to gl
+    void invalidate()
+    {
+        current_program = unknown;
+        current_vao = unknown;
+        current_fbo = unknown;
+        viewport_width = -1;
+        viewport_height = -1;
+        polygon_mode = unknown;
+        for (unsigned int i = 0; i < unit_count; i++) {
+            textures[i] = unknown;
+        }
+    }
+
+private:
+    static const unsigned int unknown = ~0u;
+    static const unsigned int unit_count = 16;
+
+    unsigned int current_program = unknown;
+    unsigned int current_vao = unknown;
+    unsigned int current_fbo = unknown;
+    int viewport_width = -1;
+    int viewport_height = -1;
+    GLenum polygon_mode = unknown;
+    unsigned int textures[unit_count] = {unknown, unknown, unknown, unknown, unknown, unknown, unknown, unknown,
+                                         unknown, unknown, unknown, unknown, unknown, unknown, unknown, unknown};
+};
+
+#endif
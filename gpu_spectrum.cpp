@@ -0,0 +1,163 @@
+#include "gpu_spectrum.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+GpuSpectrum::GpuSpectrum(AudioStream& stream, const SpectrumSettings& settings, GLState& state)
+    : stream(stream), settings(settings), state(state)
+{
+    raw_samples.reserve(settings.fft_size * stream.getChannelCount());
+    raw_samples.resize(settings.fft_size * stream.getChannelCount());
+}
+
+GpuSpectrum::~GpuSpectrum()
+{
+    unsigned int buffers[3] = {scratch, power, ranges};
+    glDeleteBuffers(3, buffers);
+    if (program != 0) {
+        glDeleteProgram(program);
+    }
+}
+
+bool GpuSpectrum::create(unsigned int texture)
+{
+    this->texture = texture;
+    program = loadComputeProgram("fftShader.comp");
+    if (program == 0) {
+        return false;
+    }
+    if (!samples.create(settings.fft_size * sizeof(float))) {
+        return false;
+    }
+
+    // the band layout comes from the cpu analyzer so both backends agree exactly
+    SpectrumAnalyzer layout(settings, stream.getSampleRate());
+    std::vector<std::uint32_t> packed(settings.bands * 4);
+    for (std::size_t b = 0; b < settings.bands; b++) {
+        packed[b * 4 + 0] = layout.getBandFirst()[b];
+        packed[b * 4 + 1] = layout.getBandLast()[b];
+        std::memcpy(&packed[b * 4 + 2], &layout.getBandCentre()[b], sizeof(float));
+        packed[b * 4 + 3] = 0;
+    }
+
+    glCreateBuffers(1, &scratch);
+    glNamedBufferStorage(scratch, (GLsizeiptr) (settings.fft_size * 2 * sizeof(float)), NULL, 0);
+    glCreateBuffers(1, &power);
+    glNamedBufferStorage(power, (GLsizeiptr) ((settings.fft_size / 2 + 1) * sizeof(float)), NULL, 0);
+    glCreateBuffers(1, &ranges);
+    glNamedBufferStorage(ranges, (GLsizeiptr) (packed.size() * sizeof(std::uint32_t)), packed.data(), 0);
+
+    unsigned int log2_size = 0;
+    while (((std::size_t) 1 << log2_size) < settings.fft_size) {
+        log2_size++;
+    }
+    glProgramUniform1ui(program, glGetUniformLocation(program, "size"), (unsigned int) settings.fft_size);
+    glProgramUniform1ui(program, glGetUniformLocation(program, "log2_size"), log2_size);
+    glProgramUniform1ui(program, glGetUniformLocation(program, "band_count"), (unsigned int) settings.bands);
+    glProgramUniform1f(program, glGetUniformLocation(program, "power_scale"), layout.getPowerScale());
+    glProgramUniform1f(program, glGetUniformLocation(program, "smoothing"), settings.smoothing);
+
+    // the release smoothing starts from silence, like the cpu analyzer
+    float zero = 0.0f;
+    glClearTexImage(texture, 0, GL_RED, GL_FLOAT, &zero);
+    return true;
+}
+
+void GpuSpectrum::analyzeWindow(const float* window)
+{
+    samples.beginFrame();
+    std::size_t offset = 0;
+    float* mono = (float*) samples.allocate(settings.fft_size * sizeof(float), offset);
+    if (mono != nullptr) {
+        std::memcpy(mono, window, settings.fft_size * sizeof(float));
+        dispatch(offset);
+    }
+    samples.endFrame();
+}
+
+void GpuSpectrum::analyzeFrame(long long frame)
+{
+    // the window is mixed straight into mapped memory
+    samples.beginFrame();
+    std::size_t offset = 0;
+    float* mono = (float*) samples.allocate(settings.fft_size * sizeof(float), offset);
+    if (mono != nullptr) {
+        readMonoWindow(stream, frame, settings.fft_size, raw_samples.data(), mono);
+        dispatch(offset);
+    }
+    samples.endFrame();
+}
+
+void GpuSpectrum::dispatch(std::size_t offset)
+{
+    state.useProgram(program);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, samples.getId(), (GLintptr) offset,
+                      (GLsizeiptr) (settings.fft_size * sizeof(float)));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, scratch);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, power);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ranges);
+    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glDispatchCompute(1, 1, 1);
+
+    // the next dispatch reuses the scratch buffers, and the visuals sample the bands
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+bool benchmarkSpectrum(AudioStream& stream, const SpectrumSettings& settings, FILE* out)
+{
+    // no smoothing, so every analysis only depends on its own window
+    SpectrumSettings bench = settings;
+    bench.smoothing = 0.0f;
+    long long track_frames = (long long) (stream.getSampleCount() / stream.getChannelCount());
+    long long count = std::min<long long>(2000, std::max<long long>(1, track_frames / (long long) bench.hop));
+
+    unsigned int texture;
+    glCreateTextures(GL_TEXTURE_1D, 1, &texture);
+    glTextureStorage1D(texture, 1, GL_R32F, (int) bench.bands);
+    GLState state;
+    Spectrum cpu(stream, bench);
+    GpuSpectrum gpu(stream, bench, state);
+    if (!gpu.create(texture)) {
+        glDeleteTextures(1, &texture);
+        return false;
+    }
+
+    // both see the same windows, and both include reading and mixing them
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < count; i++) {
+        cpu.analyzeFrame(i * (long long) bench.hop);
+    }
+    auto cpu_end = std::chrono::steady_clock::now();
+    for (long long i = 0; i < count; i++) {
+        gpu.analyzeFrame(i * (long long) bench.hop);
+    }
+    glFinish();
+    auto gpu_end = std::chrono::steady_clock::now();
+    double cpu_us = std::chrono::duration<double, std::micro>(cpu_end - start).count() / (double) count;
+    double gpu_us = std::chrono::duration<double, std::micro>(gpu_end - cpu_end).count() / (double) count;
+
+    // compare a spread of windows band by band
+    std::vector<float> gpu_bands(bench.bands);
+    float max_difference = 0.0f;
+    for (long long i = 0; i < count; i += std::max<long long>(1, count / 16)) {
+        cpu.analyzeFrame(i * (long long) bench.hop);
+        gpu.analyzeFrame(i * (long long) bench.hop);
+        glGetTextureImage(texture, 0, GL_RED, GL_FLOAT, (int) (gpu_bands.size() * sizeof(float)), gpu_bands.data());
+        for (std::size_t b = 0; b < bench.bands; b++) {
+            max_difference = std::max(max_difference, std::fabs(gpu_bands[b] - cpu.getBands()[b]));
+        }
+    }
+    glDeleteTextures(1, &texture);
+
+    fprintf(out, "fft size %zu, %zu bands, %lld windows\n", bench.fft_size, bench.bands, count);
+    fprintf(out, "cpu %.1f us per window\n", cpu_us);
+    fprintf(out, "gpu %.1f us per window, including upload and dispatch\n", gpu_us);
+    fprintf(out, "max band difference %.5f\n", max_difference);
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef GPU_SPECTRUM_H
+#define GPU_SPECTRUM_H
+
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "gl_state.h"
+#include "spectrum.h"
+#include "stream_buffer.h"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdio>
+
+// the spectrum analysis done in a compute shader: only the mono window is
+// uploaded, and the bands are written straight into the texture the visuals
+// sample, so they never come back to the cpu
+class GpuSpectrum
+{
+public:
+    GpuSpectrum(AudioStream& stream, const SpectrumSettings& settings, GLState& state);
+    ~GpuSpectrum();
+
+    GpuSpectrum(const GpuSpectrum&) = delete;
+    GpuSpectrum& operator=(const GpuSpectrum&) = delete;
+
+    // texture is an r32f 1d texture with one texel per band; false if the
+    // compute shader cannot be built, the cpu analyzer should be used then
+    bool create(unsigned int texture);
+
+    // analyse a mono window of fft size samples mixed elsewhere, the visuals
+    // get these from the analysis thread so only the upload happens here
+    void analyzeWindow(const float* window);
+
+    // read, mix and analyse the window centred on the given frame on this thread
+    void analyzeFrame(long long frame);
+
+    std::size_t getBandCount() const { return settings.bands; }
+
+private:
+    AudioStream& stream;
+    SpectrumSettings settings;
+    GLState& state;
+    AnalysisBuffer<sf::Int16> raw_samples;
+
+    unsigned int texture = 0;
+    unsigned int program = 0;
+    unsigned int scratch = 0; // complex fft data
+    unsigned int power = 0;
+    unsigned int ranges = 0; // bins per band
+    StreamBuffer samples; // one mono window per frame in flight
+
+    void dispatch(std::size_t offset);
+};
+
+// times the cpu and gpu analyzers on the same windows of the track and
+// checks they agree, needs a current context; false if the gpu one cannot run
+bool benchmarkSpectrum(AudioStream& stream, const SpectrumSettings& settings, FILE* out);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit fnv-1a, fast and plenty for telling cache entries apart
+const std::uint64_t fnv_offset = 14695981039346656037ull;
+
+inline std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename T>
+inline std::uint64_t hashValue(std::uint64_t hash, T value)
+{
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+inline std::uint64_t hashString(std::uint64_t hash, const std::string& text)
+{
+    // the length keeps "ab" + "c" apart from "a" + "bc"
+    hash = hashValue(hash, (std::uint64_t) text.size());
+    return hashBytes(hash, text.data(), text.size());
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "normalizer.h"
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+#include "decimate.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+bool parseNormalizeMode(const char* name, NormalizeMode& mode)
+{
+    if (std::strcmp(name, "running") == 0) {
+        mode = NormalizeMode::Running;
+    } else if (std::strcmp(name, "track") == 0) {
+        mode = NormalizeMode::Track;
+    } else if (std::strcmp(name, "window") == 0) {
+        mode = NormalizeMode::Window;
+    } else if (std::strcmp(name, "agc") == 0) {
+        mode = NormalizeMode::Agc;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* normalizeModeName(NormalizeMode mode)
+{
+    switch (mode) {
+    case NormalizeMode::Running:
+        return "running";
+    case NormalizeMode::Track:
+        return "track";
+    case NormalizeMode::Window:
+        return "window";
+    case NormalizeMode::Agc:
+        return "agc";
+    }
+    return "unknown";
+}
+
+void Normalizer::setTrackPeak(float peak)
+{
+    track_peak = std::max(peak, floor_level);
+}
+
+float Normalizer::apply(float level, double seconds)
+{
+    switch (settings.mode) {
+    case NormalizeMode::Running:
+        reference = std::max(reference, level);
+        break;
+    case NormalizeMode::Track:
+        reference = track_peak;
+        break;
+    case NormalizeMode::Window:
+        // time went back, levels from the skipped stretch never happened
+        while (!window.empty() && window.back().seconds > seconds) {
+            window.pop_back();
+        }
+        // anything quieter than the new level can never be the loudest again
+        while (!window.empty() && window.back().level <= level) {
+            window.pop_back();
+        }
+        window.push_back({seconds, level});
+        while (window.front().seconds < seconds - settings.window_seconds) {
+            window.pop_front();
+        }
+        reference = std::max(window.front().level, floor_level);
+        break;
+    case NormalizeMode::Agc: {
+        double dt = started ? std::max(seconds - last_seconds, 0.0) : 0.0;
+        if (!started) {
+            follower = level;
+            started = true;
+        }
+        last_seconds = seconds;
+        double time = level > follower ? settings.attack_seconds : settings.release_seconds;
+        float k = time > 0.0 ? (float) (1.0 - std::exp(-dt / time)) : 1.0f;
+        follower += (level - follower) * k;
+        // a steady level shows at the target, leaving room above it for peaks
+        reference = std::max(follower, floor_level) / settings.agc_target;
+        break;
+    }
+    }
+    return std::min(std::max(level / reference, 0.0f), 1.0f);
+}
+
+float scanTrackPeak(const std::string& audio_path, std::size_t window_frames)
+{
+    AudioStream probe;
+    if (!probe.open(audio_path)) {
+        return -1.0f;
+    }
+    unsigned int channels = probe.getChannelCount();
+    window_frames = std::max<std::size_t>(window_frames, 1);
+    std::uint64_t window_count = probe.getSampleCount() / channels / window_frames;
+
+    // same split as the feature cache builder, each range decodes on its own
+    const std::uint64_t range_windows = 4096;
+    const std::size_t chunk_windows = 64;
+    std::size_t range_count = (std::size_t) ((window_count + range_windows - 1) / range_windows);
+    std::vector<float> range_peaks(range_count, 0.0f);
+    std::atomic<bool> failed{false};
+    {
+        // only called when the cache builder is not decoding the same track, so use every core
+        ThreadPool pool;
+        pool.parallelFor(range_count, [&](std::size_t i) {
+            AudioStream stream(8192, 2);
+            if (failed || !stream.open(audio_path)) {
+                failed = true;
+                return;
+            }
+            AnalysisBuffer<sf::Int16> raw_samples(chunk_windows * window_frames * channels);
+            AnalysisBuffer<float> peak(chunk_windows);
+            AnalysisBuffer<float> rms(chunk_windows);
+            std::uint64_t end = std::min<std::uint64_t>((i + 1) * range_windows, window_count);
+            for (std::uint64_t first = i * range_windows; first < end; first += chunk_windows) {
+                std::size_t got = stream.read(first * window_frames * channels, raw_samples.data(), raw_samples.capacity());
+                std::size_t windows = decimateEnvelope(raw_samples.data(), got / channels, channels,
+                                                       window_frames, peak.data(), rms.data());
+                windows = (std::size_t) std::min<std::uint64_t>(windows, end - first);
+                for (std::size_t w = 0; w < windows; w++) {
+                    range_peaks[i] = std::max(range_peaks[i], rms[w]);
+                }
+            }
+        });
+    }
+    if (failed) {
+        return -1.0f;
+    }
+    float peak = 0.0f;
+    for (float range_peak : range_peaks) {
+        peak = std::max(peak, range_peak);
+    }
+    return peak;
+}
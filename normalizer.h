@@ -0,0 +1,75 @@
+#ifndef NORMALIZER_H
+#define NORMALIZER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+// how envelope levels are scaled to a [0, 1] brightness
+enum class NormalizeMode
+{
+    Running, // loudest level so far, never comes back down
+    Track, // loudest level of the whole track, found before rendering
+    Window, // loudest level of the last few seconds
+    Agc // a gain that follows the level with an attack and a release, towards a target brightness
+};
+
+struct NormalizeSettings
+{
+    NormalizeMode mode = NormalizeMode::Running;
+    double window_seconds = 10.0; // how far back the window mode looks
+    double attack_seconds = 0.05; // how fast the agc reacts to a louder level
+    double release_seconds = 3.0; // and how slowly it lets go
+    float agc_target = 0.5f; // brightness the agc holds a steady level at, louder moments get the rest
+};
+
+// false for an unknown mode name
+bool parseNormalizeMode(const char* name, NormalizeMode& mode);
+const char* normalizeModeName(NormalizeMode mode);
+
+// turns a stream of envelope levels into brightness, one level per rendered frame
+// levels should arrive in time order, a jump back (the clock resyncing) is
+// taken as a fresh start for whatever came after; the offline mode only needs setTrackPeak
+class Normalizer
+{
+public:
+    explicit Normalizer(const NormalizeSettings& settings) : settings(settings) {}
+
+    // the loudest level of the track, from the feature cache or scanTrackPeak
+    void setTrackPeak(float peak);
+
+    // scaled level at the given time, clamped to [0, 1]
+    float apply(float level, double seconds);
+
+    // what the last level was divided by
+    float getReference() const { return reference; }
+
+private:
+    struct Entry
+    {
+        double seconds;
+        float level;
+    };
+
+    NormalizeSettings settings;
+    float reference = floor_level;
+    float track_peak = floor_level;
+
+    // window mode, levels in decreasing order so the front is always the loudest
+    std::deque<Entry> window;
+
+    // agc mode, the level the gain follows
+    float follower = 0.0f;
+    double last_seconds = 0.0;
+    bool started = false;
+
+    // nothing quieter than one lsb of 16 bit audio gets scaled up
+    static constexpr float floor_level = 1.0f / 32768.0f;
+};
+
+// loudest window rms of a whole file, the track is split into ranges decoded
+// in parallel; returns a negative value if the file cannot be read
+// only for when there is no feature cache to read the peak from
+float scanTrackPeak(const std::string& audio_path, std::size_t window_frames);
+
+#endif
@@ -0,0 +1,260 @@
+#include "options.h"
+#include "analysis_thread.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// reads the number following argv[i] and moves i past it
+static bool parseSize(int argc, char* argv[], int& i, std::size_t& value)
+{
+    if (i + 1 >= argc) {
+        printf("%s needs a value\n", argv[i]);
+        return false;
+    }
+    char* end;
+    long long parsed = std::strtoll(argv[i + 1], &end, 10);
+    if (*end != '\0' || parsed <= 0) {
+        printf("%s needs a positive number, got %s\n", argv[i], argv[i + 1]);
+        return false;
+    }
+    value = (std::size_t) parsed;
+    i++;
+    return true;
+}
+
+// reads a number in (0, 1] following argv[i] and moves i past it
+static bool parseFraction(int argc, char* argv[], int& i, float& value)
+{
+    if (i + 1 >= argc) {
+        printf("%s needs a value\n", argv[i]);
+        return false;
+    }
+    char* end;
+    float parsed = std::strtof(argv[i + 1], &end);
+    if (*end != '\0' || !(parsed > 0.0f && parsed <= 1.0f)) {
+        printf("%s needs a number above 0 and at most 1, got %s\n", argv[i], argv[i + 1]);
+        return false;
+    }
+    value = parsed;
+    i++;
+    return true;
+}
+
+// reads a WIDTHxHEIGHT value following argv[i] and moves i past it
+static bool parseResolution(int argc, char* argv[], int& i, int& width, int& height)
+{
+    if (i + 1 >= argc) {
+        printf("%s needs a value\n", argv[i]);
+        return false;
+    }
+    if (std::sscanf(argv[i + 1], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        printf("%s needs a resolution like 1920x1080, got %s\n", argv[i], argv[i + 1]);
+        return false;
+    }
+    i++;
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--play") == 0) {
+            options.play = true;
+        } else if (std::strcmp(arg, "--visual") == 0) {
+            if (i + 1 >= argc) {
+                printf("--visual needs a name\n");
+                return false;
+            }
+            options.visual = argv[++i];
+        } else if (std::strcmp(arg, "--bars") == 0) {
+            if (!parseSize(argc, argv, i, options.bars)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--capture") == 0) {
+            options.capturing = true;
+        } else if (std::strcmp(arg, "--capture-device") == 0) {
+            if (i + 1 >= argc) {
+                printf("--capture-device needs a device name\n");
+                return false;
+            }
+            options.capturing = true;
+            options.capture_device = argv[++i];
+        } else if (std::strcmp(arg, "--capture-file") == 0) {
+            if (i + 1 >= argc) {
+                printf("--capture-file needs a file name\n");
+                return false;
+            }
+            options.capturing = true;
+            options.capture_file = argv[++i];
+        } else if (std::strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(arg, "--size") == 0) {
+            if (!parseResolution(argc, argv, i, options.width, options.height)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--export") == 0) {
+            // the target is required, another option in its place means it was left out
+            if (i + 1 >= argc || std::strncmp(argv[i + 1], "--", 2) == 0) {
+                printf("--export needs a directory, or - for stdout\n");
+                return false;
+            }
+            options.exporting = true;
+            options.export_settings.target = argv[++i];
+        } else if (std::strcmp(arg, "--format") == 0) {
+            if (i + 1 >= argc || !parseExportFormat(argv[i + 1], options.export_settings.format)) {
+                printf("--format needs one of raw, ppm or png\n");
+                return false;
+            }
+            i++;
+        } else if (std::strcmp(arg, "--fps") == 0) {
+            std::size_t fps;
+            if (!parseSize(argc, argv, i, fps)) {
+                return false;
+            }
+            options.export_settings.fps = (int) fps;
+        } else if (std::strcmp(arg, "--export-threads") == 0) {
+            std::size_t threads;
+            if (!parseSize(argc, argv, i, threads)) {
+                return false;
+            }
+            options.export_settings.threads = (unsigned int) threads;
+        } else if (std::strcmp(arg, "--profile") == 0) {
+            if (i + 1 >= argc) {
+                printf("--profile needs a file name\n");
+                return false;
+            }
+            options.profile_file = argv[++i];
+        } else if (std::strcmp(arg, "--no-shader-cache") == 0) {
+            options.shader_cache = false;
+        } else if (std::strcmp(arg, "--no-cache") == 0) {
+            options.use_cache = false;
+        } else if (std::strcmp(arg, "--cache-no-spectra") == 0) {
+            options.cache_spectra = false;
+        } else if (std::strcmp(arg, "--fft-size") == 0) {
+            if (!parseSize(argc, argv, i, options.spectrum.fft_size)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--hop") == 0) {
+            if (!parseSize(argc, argv, i, options.spectrum.hop)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--bands") == 0) {
+            if (!parseSize(argc, argv, i, options.spectrum.bands)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--analysis") == 0) {
+            if (i + 1 >= argc || (std::strcmp(argv[i + 1], "cpu") != 0 && std::strcmp(argv[i + 1], "gpu") != 0)) {
+                printf("--analysis needs cpu or gpu\n");
+                return false;
+            }
+            options.gpu_analysis = std::strcmp(argv[++i], "gpu") == 0;
+        } else if (std::strcmp(arg, "--normalize") == 0) {
+            if (i + 1 >= argc || !parseNormalizeMode(argv[i + 1], options.normalize.mode)) {
+                printf("--normalize needs running, track, window or agc\n");
+                return false;
+            }
+            i++;
+        } else if (std::strcmp(arg, "--normalize-window") == 0) {
+            std::size_t seconds;
+            if (!parseSize(argc, argv, i, seconds)) {
+                return false;
+            }
+            options.normalize.window_seconds = (double) seconds;
+        } else if (std::strcmp(arg, "--agc-target") == 0) {
+            if (!parseFraction(argc, argv, i, options.normalize.agc_target)) {
+                return false;
+            }
+        } else if (std::strcmp(arg, "--bench-analysis") == 0) {
+            options.bench_analysis = true;
+        } else if (std::strcmp(arg, "-") == 0) {
+            // - only means stdout as an export target, audio cannot be read from stdin
+            printf("Audio cannot be read from stdin, give a file name\n");
+            return false;
+        } else if (arg[0] == '-') {
+            printf("Unknown option %s\n", arg);
+            return false;
+        } else if (options.audio_file.empty()) {
+            options.audio_file = arg;
+        } else {
+            printf("Only one audio file can be visualised at a time\n");
+            return false;
+        }
+    }
+
+    if (options.capturing) {
+        // a live input has no end and nothing to read ahead of time
+        if (!options.audio_file.empty()) {
+            printf("A file cannot be visualised while capturing, use --capture-file to fake the input\n");
+            return false;
+        }
+        if (options.exporting || options.play || options.gpu_analysis || options.bench_analysis) {
+            printf("--export, --play, --analysis gpu and --bench-analysis need a file, not a live input\n");
+            return false;
+        }
+        if (options.visual == "waveform") {
+            printf("--visual waveform needs a file, a live input has no end to summarise\n");
+            return false;
+        }
+        if (options.normalize.mode == NormalizeMode::Track) {
+            printf("--normalize track needs a file, a live input has no end to scan to\n");
+            return false;
+        }
+        options.use_cache = false;
+    } else if (options.audio_file.empty()) {
+        printf("No audio file provided\n");
+        return false;
+    }
+    if (options.exporting) {
+        // exported frames follow their own clock, not the sound card or a monitor
+        if (options.play) {
+            printf("--play cannot be used with --export\n");
+            return false;
+        }
+        options.headless = true;
+    }
+    if (options.bench_analysis) {
+        // only needs a context for the compute shader
+        options.headless = true;
+    }
+    if (options.spectrum.bands > FeatureFrame::max_bands) {
+        printf("--bands can be at most %zu\n", FeatureFrame::max_bands);
+        return false;
+    }
+    if (!isValidFFTSize(options.spectrum.fft_size)) {
+        printf("FFT size must be a power of two from 512 to 8192\n");
+        return false;
+    }
+    return true;
+}
+
+void printUsage(const char* program)
+{
+    printf("usage: %s [options] audio_file\n", program);
+    printf("       %s [options] --capture\n", program);
+    printf("  --play              play the track and sync the visuals to it\n");
+    printf("  --capture           visualise the default input device instead of a file\n");
+    printf("  --capture-device D  visualise the named input device\n");
+    printf("  --capture-file FILE fake a live input by feeding a file in at real time\n");
+    printf("  --visual NAME       simple, glow, bars or waveform (simple)\n");
+    printf("  --bars N            number of bars for the bars visual (256)\n");
+    printf("  --headless          render offscreen, no window or monitor needed\n");
+    printf("  --size WxH          offscreen resolution (1920x1080)\n");
+    printf("  --export DIR        render offline into an image sequence, - writes to stdout\n");
+    printf("  --format FMT        export format, raw (rgba), ppm or png (ppm)\n");
+    printf("  --fps N             export frame rate (60)\n");
+    printf("  --export-threads N  frame encoder threads (one per core)\n");
+    printf("  --profile FILE      write per frame timings on exit, .json or csv\n");
+    printf("  --no-shader-cache   always compile shaders from source\n");
+    printf("  --no-cache          neither read nor write the .vfeat feature cache\n");
+    printf("  --cache-no-spectra  only cache the envelope, spectra are computed live\n");
+    printf("  --fft-size N        spectrum fft size, power of two from 512 to 8192 (2048)\n");
+    printf("  --hop N             frames between spectrum updates (512)\n");
+    printf("  --bands N           number of log spaced spectrum bands (64)\n");
+    printf("  --analysis WHERE    run the spectrum on the cpu or in a gpu compute shader (cpu)\n");
+    printf("  --normalize MODE    running, track, window or agc brightness scaling (running)\n");
+    printf("  --normalize-window S seconds the window mode looks back over (10)\n");
+    printf("  --agc-target X      brightness the agc mode holds a steady level at, 0 to 1 (0.5)\n");
+    printf("  --bench-analysis    time the cpu and gpu spectrum on the track and exit\n");
+}
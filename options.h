@@ -0,0 +1,40 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "export.h"
+#include "normalizer.h"
+#include "spectrum.h"
+
+#include <string>
+
+// everything that can be set from the command line
+struct Options
+{
+    std::string audio_file;
+    bool capturing = false; // visualise a live input instead of a file
+    std::string capture_device; // empty is the system default
+    std::string capture_file; // fake the live input with this file, no device needed
+    bool play = false; // play the track and follow its clock
+    bool headless = false; // no window, render offscreen
+    int width = 1920; // offscreen resolution
+    int height = 1080;
+    bool exporting = false; // render every frame offline and write it out
+    ExportSettings export_settings;
+    std::string visual = "simple"; // which list of render passes to run
+    std::size_t bars = 256; // bars drawn by the bars visual
+    SpectrumSettings spectrum;
+    NormalizeSettings normalize;
+    bool gpu_analysis = false; // run the spectrum in a compute shader
+    bool bench_analysis = false; // time the cpu and gpu spectrum, then exit
+    std::string profile_file; // per frame timings written here on exit, csv or json
+    bool shader_cache = true; // keep linked shader binaries in shader_cache/
+    bool use_cache = true; // read and write the .vfeat feature cache
+    bool cache_spectra = true; // include spectra in the cache, not just the envelope
+};
+
+// returns false (after printing why) if the arguments make no sense
+bool parseOptions(int argc, char* argv[], Options& options);
+
+void printUsage(const char* program);
+
+#endif
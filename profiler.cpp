@@ -0,0 +1,201 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char* section_names[] = {"analysis", "upload", "input", "draw", "export", "events", "swap"};
+
+// columns past the sections
+static const int cpu_column = (int) ProfileSection::Count;
+static const int gpu_column = cpu_column + 1;
+
+FrameProfiler::FrameProfiler(std::size_t max_frames)
+    : frames(std::max<std::size_t>(max_frames, 1))
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if (gpu) {
+        glDeleteQueries((int) query_count, queries);
+    }
+}
+
+void FrameProfiler::initGpu()
+{
+    // several queries in flight so reading a result never waits on the gpu
+    glGenQueries((int) query_count, queries);
+    gpu = true;
+}
+
+void FrameProfiler::beginFrame()
+{
+    frame++;
+    frame_start = Clock::now();
+    last_mark = frame_start;
+
+    FrameRecord& current = record(frame);
+    std::memset(&current, 0, sizeof(current));
+    current.gpu_ms = -1.0f;
+
+    if (gpu) {
+        std::size_t q = (std::size_t) (frame % (long long) query_count);
+        if (query_frame[q] >= 0) {
+            collectGpu(q); // only waits if the gpu is query_count frames behind
+        }
+        glBeginQuery(GL_TIME_ELAPSED, queries[q]);
+        query_frame[q] = frame;
+    }
+}
+
+void FrameProfiler::mark(ProfileSection section)
+{
+    Clock::time_point now = Clock::now();
+    record(frame).section_ms[(int) section] += std::chrono::duration<float, std::milli>(now - last_mark).count();
+    last_mark = now;
+}
+
+void FrameProfiler::endFrame()
+{
+    if (gpu) {
+        glEndQuery(GL_TIME_ELAPSED);
+        collectGpu(query_count);
+    }
+    FrameRecord& current = record(frame);
+    current.cpu_ms = std::chrono::duration<float, std::milli>(Clock::now() - frame_start).count();
+    worst_frame = std::max(worst_frame, current.cpu_ms);
+}
+
+void FrameProfiler::collectGpu(std::size_t wait_slot)
+{
+    for (std::size_t q = 0; q < query_count; q++) {
+        if (query_frame[q] < 0 || query_frame[q] == frame) {
+            continue;
+        }
+        int available = 0;
+        glGetQueryObjectiv(queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && q != wait_slot) {
+            continue;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(queries[q], GL_QUERY_RESULT, &elapsed);
+
+        // the record may have been recycled already if we kept very few frames
+        if (frame - query_frame[q] < (long long) frames.size()) {
+            record(query_frame[q]).gpu_ms = (float) ((double) elapsed / 1e6);
+        }
+        query_frame[q] = -1;
+    }
+}
+
+float FrameProfiler::takeWorstFrame()
+{
+    float worst = worst_frame;
+    worst_frame = 0.0f;
+    return worst;
+}
+
+void FrameProfiler::column(int which, std::vector<float>& values) const
+{
+    values.clear();
+    long long kept = std::min(frame + 1, (long long) frames.size());
+    for (long long f = frame + 1 - kept; f <= frame; f++) {
+        const FrameRecord& r = frames[(std::size_t) (f % (long long) frames.size())];
+        float v = (which == cpu_column) ? r.cpu_ms : (which == gpu_column) ? r.gpu_ms : r.section_ms[which];
+        if (v >= 0.0f) {
+            values.push_back(v);
+        }
+    }
+}
+
+// nearest rank percentile, values gets reordered
+static float percentile(std::vector<float>& values, double p)
+{
+    if (values.empty()) {
+        return 0.0f;
+    }
+    std::size_t rank = (std::size_t) (p * (double) (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + (std::ptrdiff_t) rank, values.end());
+    return values[rank];
+}
+
+void FrameProfiler::report(std::FILE* out) const
+{
+    long long kept = std::min(frame + 1, (long long) frames.size());
+    std::fprintf(out, "frame times over the last %lld frames (ms)\n", kept);
+    std::fprintf(out, "%-10s %8s %8s %8s\n", "", "p50", "p99", "max");
+
+    std::vector<float> values;
+    for (int c = 0; c <= gpu_column; c++) {
+        column(c, values);
+        if (values.empty()) {
+            continue;
+        }
+        const char* name = (c == cpu_column) ? "cpu frame" : (c == gpu_column) ? "gpu frame" : section_names[c];
+        float p50 = percentile(values, 0.50);
+        float p99 = percentile(values, 0.99);
+        float max = *std::max_element(values.begin(), values.end());
+        std::fprintf(out, "%-10s %8.3f %8.3f %8.3f\n", name, p50, p99, max);
+    }
+}
+
+bool FrameProfiler::dump(const std::string& path) const
+{
+    std::FILE* out = std::fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    bool ok = json ? dumpJson(out) : dumpCsv(out);
+    return (std::fclose(out) == 0) && ok;
+}
+
+bool FrameProfiler::dumpCsv(std::FILE* out) const
+{
+    std::fprintf(out, "frame");
+    for (const char* name : section_names) {
+        std::fprintf(out, ",%s", name);
+    }
+    std::fprintf(out, ",cpu,gpu\n");
+
+    long long kept = std::min(frame + 1, (long long) frames.size());
+    for (long long f = frame + 1 - kept; f <= frame; f++) {
+        const FrameRecord& r = frames[(std::size_t) (f % (long long) frames.size())];
+        std::fprintf(out, "%lld", f);
+        for (float ms : r.section_ms) {
+            std::fprintf(out, ",%.4f", ms);
+        }
+        std::fprintf(out, ",%.4f,%.4f\n", r.cpu_ms, r.gpu_ms);
+    }
+    return !std::ferror(out);
+}
+
+bool FrameProfiler::dumpJson(std::FILE* out) const
+{
+    std::fprintf(out, "{\n  \"summary\": {");
+    std::vector<float> values;
+    bool first = true;
+    for (int c = 0; c <= gpu_column; c++) {
+        column(c, values);
+        const char* name = (c == cpu_column) ? "cpu" : (c == gpu_column) ? "gpu" : section_names[c];
+        float p50 = percentile(values, 0.50);
+        float p99 = percentile(values, 0.99);
+        float max = values.empty() ? 0.0f : *std::max_element(values.begin(), values.end());
+        std::fprintf(out, "%s\n    \"%s\": {\"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+                     first ? "" : ",", name, p50, p99, max);
+        first = false;
+    }
+    std::fprintf(out, "\n  },\n  \"frames\": [");
+
+    long long kept = std::min(frame + 1, (long long) frames.size());
+    for (long long f = frame + 1 - kept; f <= frame; f++) {
+        const FrameRecord& r = frames[(std::size_t) (f % (long long) frames.size())];
+        std::fprintf(out, "%s\n    {\"frame\": %lld", f == frame + 1 - kept ? "" : ",", f);
+        for (int s = 0; s < (int) ProfileSection::Count; s++) {
+            std::fprintf(out, ", \"%s\": %.4f", section_names[s], r.section_ms[s]);
+        }
+        std::fprintf(out, ", \"cpu\": %.4f, \"gpu\": %.4f}", r.cpu_ms, r.gpu_ms);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    return !std::ferror(out);
+}
@@ -0,0 +1,87 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// parts of a frame, in the order the render loop runs them
+enum class ProfileSection
+{
+    Analysis,
+    Upload,
+    Input,
+    Draw,
+    Export,
+    Events, // window system events, polled just before the swap
+    Swap,
+    Count
+};
+
+// per frame cpu timings of every section, plus gpu time from timer queries
+// the last max_frames frames are kept for percentiles and dumps, so only ask
+// for a long history when the frames are actually going to be dumped
+class FrameProfiler
+{
+public:
+    explicit FrameProfiler(std::size_t max_frames = 1 << 19);
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // needs a current gl context, without it only cpu time is recorded
+    void initGpu();
+
+    void beginFrame();
+
+    // everything since the last mark (or the frame start) was spent in section
+    void mark(ProfileSection section);
+
+    void endFrame();
+
+    // worst whole frame in ms since the last call, for the once a second log line
+    float takeWorstFrame();
+
+    // p50, p99 and max of every section
+    void report(std::FILE* out) const;
+
+    // .json gets json, anything else csv
+    bool dump(const std::string& path) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct FrameRecord
+    {
+        float section_ms[(int) ProfileSection::Count];
+        float cpu_ms;
+        float gpu_ms; // negative until the query result arrives
+    };
+
+    static const std::size_t query_count = 4;
+
+    FrameRecord& record(long long frame) { return frames[(std::size_t) (frame % (long long) frames.size())]; }
+    // read back finished queries, blocking only on wait_slot (query_count for none)
+    void collectGpu(std::size_t wait_slot);
+    void column(int which, std::vector<float>& values) const;
+    bool dumpCsv(std::FILE* out) const;
+    bool dumpJson(std::FILE* out) const;
+
+    std::vector<FrameRecord> frames;
+    long long frame = -1;
+    Clock::time_point frame_start;
+    Clock::time_point last_mark;
+    float worst_frame = 0.0f;
+
+    // queries in flight, query i belongs to frame query_frame[i]
+    bool gpu = false;
+    unsigned int queries[query_count] = {0, 0, 0, 0};
+    long long query_frame[query_count] = {-1, -1, -1, -1};
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <iostream>
+
+RenderGraph::RenderGraph(GLState& state) : state(state)
+{
+    // fullscreen passes build their triangle from gl_VertexID, but core
+    // profile still wants some vao bound
+    glGenVertexArrays(1, &empty_vao);
+}
+
+RenderGraph::~RenderGraph()
+{
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void RenderGraph::addExternal(const std::string& name, unsigned int texture)
+{
+    externals[name] = texture;
+}
+
+void RenderGraph::addHistory(const std::string& name)
+{
+    histories[name] = std::make_unique<History>();
+    compiled = false;
+}
+
+void RenderGraph::addPass(const RenderPass& pass)
+{
+    passes.push_back(pass);
+    compiled = false;
+}
+
+bool RenderGraph::compile(int width, int height)
+{
+    if (compiled && width == this->width && height == this->height) {
+        return true;
+    }
+    this->width = width;
+    this->height = height;
+    transient_targets.clear();
+    transient_slot.clear();
+
+    // lifetime of every transient, from the pass writing it to the last pass reading it
+    std::map<std::string, std::pair<int, int>> lifetime;
+    std::vector<std::string> order; // by first write
+    for (int p = 0; p < (int) passes.size(); p++) {
+        for (const PassInput& input : passes[p].inputs) {
+            if (externals.count(input.resource) || histories.count(input.resource)) {
+                continue;
+            }
+            auto found = lifetime.find(input.resource);
+            if (found == lifetime.end()) {
+                std::cout << "ERROR::RENDER_GRAPH::" << passes[p].name << " reads " << input.resource
+                          << " before anything writes it" << std::endl;
+                return false;
+            }
+            found->second.second = p;
+        }
+        const std::string& output = passes[p].output;
+        if (!output.empty() && !externals.count(output) && !histories.count(output) && !lifetime.count(output)) {
+            lifetime[output] = std::make_pair(p, p);
+            order.push_back(output);
+        }
+    }
+
+    // greedy interval colouring, a target is reused once its last reader has run
+    std::vector<int> busy_until;
+    for (const std::string& name : order) {
+        std::pair<int, int> life = lifetime[name];
+        std::size_t slot = 0;
+        while (slot < busy_until.size() && busy_until[slot] >= life.first) {
+            slot++;
+        }
+        if (slot == busy_until.size()) {
+            transient_targets.push_back(std::make_unique<Framebuffer>());
+            if (!transient_targets.back()->create(width, height)) {
+                return false;
+            }
+            busy_until.push_back(life.second);
+        } else {
+            busy_until[slot] = life.second;
+        }
+        transient_slot[name] = slot;
+    }
+
+    for (auto& history : histories) {
+        for (Framebuffer& target : history.second->targets) {
+            if (!target.create(width, height)) {
+                return false;
+            }
+            target.bind();
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // creating targets bound textures and framebuffers without telling the cache
+    state.invalidate();
+    compiled = true;
+    return true;
+}
+
+const Framebuffer* RenderGraph::writeTarget(const std::string& name)
+{
+    auto history = histories.find(name);
+    if (history != histories.end()) {
+        return &history->second->targets[frame % 2];
+    }
+    auto transient = transient_slot.find(name);
+    if (transient != transient_slot.end()) {
+        return transient_targets[transient->second].get();
+    }
+    return nullptr;
+}
+
+bool RenderGraph::inputTexture(const PassInput& input, unsigned int& texture)
+{
+    auto external = externals.find(input.resource);
+    if (external != externals.end()) {
+        texture = external->second;
+        return true;
+    }
+    auto history = histories.find(input.resource);
+    if (history != histories.end()) {
+        texture = history->second->targets[(frame + (input.previous ? 1 : 0)) % 2].getTexture();
+        return true;
+    }
+    auto transient = transient_slot.find(input.resource);
+    if (transient != transient_slot.end()) {
+        texture = transient_targets[transient->second]->getTexture();
+        return true;
+    }
+    return false;
+}
+
+void RenderGraph::execute(unsigned int final_fbo, int final_width, int final_height)
+{
+    for (RenderPass& pass : passes) {
+        const Framebuffer* target = pass.output.empty() ? nullptr : writeTarget(pass.output);
+        if (target != nullptr) {
+            state.bindFramebuffer(target->getId());
+            state.viewport(target->getWidth(), target->getHeight());
+        } else {
+            state.bindFramebuffer(final_fbo);
+            state.viewport(final_width, final_height);
+        }
+
+        unsigned int program = pass.shader->getId();
+        state.useProgram(program);
+        if (pass.located_program != program) {
+            pass.locations.clear();
+            for (const PassInput& input : pass.inputs) {
+                pass.locations.push_back(glGetUniformLocation(program, input.uniform.c_str()));
+            }
+            pass.located_program = program;
+        }
+        for (std::size_t i = 0; i < pass.inputs.size(); i++) {
+            unsigned int texture;
+            if (!inputTexture(pass.inputs[i], texture)) {
+                continue;
+            }
+            state.bindTexture((unsigned int) i, texture);
+            glUniform1i(pass.locations[i], (int) i);
+        }
+        if (pass.setup) {
+            pass.setup(program);
+        }
+
+        if (pass.draw) {
+            pass.draw();
+        } else {
+            state.polygonMode(GL_FILL);
+            state.bindVertexArray(empty_vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+    frame++;
+}
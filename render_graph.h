@@ -0,0 +1,99 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "framebuffer.h"
+#include "gl_state.h"
+#include "shader.h"
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// a texture a pass samples, bound to the sampler uniform of the same slot
+struct PassInput
+{
+    std::string uniform;
+    std::string resource;
+    bool previous = false; // last frame's contents of a history resource
+};
+
+// one step of a visual: a program reading some resources and drawing into another
+struct RenderPass
+{
+    std::string name;
+    ShaderProgram* shader = nullptr;
+    std::vector<PassInput> inputs;
+    std::string output; // empty draws into the final target
+
+    // extra uniforms, called with the program bound
+    std::function<void(unsigned int program)> setup;
+
+    // defaults to one fullscreen triangle
+    std::function<void()> draw;
+
+    // sampler locations, looked up again whenever the program is rebuilt
+    unsigned int located_program = 0;
+    std::vector<int> locations;
+};
+
+// runs a list of passes every frame; intermediate targets are allocated once
+// and targets whose lifetimes do not overlap share the same framebuffer
+class RenderGraph
+{
+public:
+    // every bind goes through state, so passes sharing a program or target skip the rebind
+    explicit RenderGraph(GLState& state);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // a texture owned by someone else, like the spectrum
+    void addExternal(const std::string& name, unsigned int texture);
+
+    // a target that survives into the next frame, for feedback effects
+    void addHistory(const std::string& name);
+
+    // any output that is not external or history becomes a transient target
+    void addPass(const RenderPass& pass);
+
+    // work out lifetimes and allocate the targets, nothing happens if the size
+    // did not change, false if a pass reads something nobody wrote yet
+    bool compile(int width, int height);
+
+    // run every pass, the last output goes into final_fbo
+    void execute(unsigned int final_fbo, int final_width, int final_height);
+
+    // framebuffers actually allocated for transients, after aliasing
+    std::size_t getTransientTargetCount() const { return transient_targets.size(); }
+
+private:
+    // the two halves of a history resource swap roles every frame
+    struct History
+    {
+        Framebuffer targets[2];
+    };
+
+    const Framebuffer* writeTarget(const std::string& name);
+    bool inputTexture(const PassInput& input, unsigned int& texture);
+
+    std::vector<RenderPass> passes;
+    std::map<std::string, unsigned int> externals;
+    std::map<std::string, std::unique_ptr<History>> histories;
+
+    std::vector<std::unique_ptr<Framebuffer>> transient_targets;
+    std::map<std::string, std::size_t> transient_slot; // resource -> transient_targets index
+
+    GLState& state;
+    unsigned int empty_vao = 0;
+    int width = 0;
+    int height = 0;
+    bool compiled = false;
+    long long frame = 0;
+};
+
+#endif
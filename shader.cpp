@@ -0,0 +1,472 @@
+#include "shader.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// from KHR_parallel_shader_compile, glad was generated without extensions
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+bool readTextFile(const std::string& path, std::string& text)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream sstream;
+    sstream << file.rdbuf();
+    text = sstream.str();
+    return true;
+}
+
+// the directory holding a file, editors often replace files instead of writing them
+static std::string parentDirectory(const std::string& path)
+{
+    std::string parent = std::filesystem::path(path).parent_path().string();
+    return parent.empty() ? "." : parent;
+}
+
+void ShaderWatcher::add(const std::string& path)
+{
+    WatchedFile file = {path, parentDirectory(path), std::filesystem::path(path).filename().string()};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const WatchedFile& watched : files) {
+            if (watched.path == path) {
+                return;
+            }
+        }
+        files.push_back(file);
+    }
+#ifdef __linux__
+    if (fd < 0) {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            std::cout << "Failed to watch shaders" << std::endl;
+            return;
+        }
+    }
+    // a directory already watched gives back the same watch
+    int watch = inotify_add_watch(fd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (watch >= 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        directories[watch] = file.directory;
+    }
+#endif
+    if (!worker.joinable()) {
+        stopping = false;
+        worker = std::thread(&ShaderWatcher::run, this);
+    }
+}
+
+void ShaderWatcher::stop()
+{
+    stopping = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+#ifdef __linux__
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    directories.clear();
+#endif
+}
+
+bool ShaderWatcher::takeChanges(std::map<std::string, std::string>& sources)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (changed.empty()) {
+        return false;
+    }
+    sources.swap(changed);
+    changed.clear();
+    return true;
+}
+
+void ShaderWatcher::readSource(const std::string& path)
+{
+    std::string source;
+    if (!readTextFile(path, source)) {
+        return; // probably mid save, the next event will catch it
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    changed[path].swap(source);
+}
+
+#ifdef __linux__
+void ShaderWatcher::run()
+{
+    alignas(inotify_event) char buffer[4096];
+    std::vector<std::string> touched;
+    bool pending = false;
+    while (!stopping) {
+        // wake up now and then to notice stop(), and to read a settled burst
+        pollfd waiting = {fd, POLLIN, 0};
+        if (poll(&waiting, 1, pending ? 30 : 100) <= 0) {
+            // saves often come as a burst of events, they are read once it settles
+            if (pending) {
+                for (const std::string& path : touched) {
+                    readSource(path);
+                }
+                touched.clear();
+                pending = false;
+            }
+            continue;
+        }
+
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (char* p = buffer; p < buffer + length;) {
+                inotify_event* event = reinterpret_cast<inotify_event*>(p);
+                auto directory = directories.find(event->wd);
+                if (event->len > 0 && directory != directories.end()) {
+                    for (const WatchedFile& file : files) {
+                        if (file.directory == directory->second && file.name == event->name
+                            && std::find(touched.begin(), touched.end(), file.path) == touched.end()) {
+                            touched.push_back(file.path);
+                            pending = true;
+                        }
+                    }
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+    }
+}
+#else
+void ShaderWatcher::run()
+{
+    std::map<std::string, std::filesystem::file_time_type> times;
+    while (!stopping) {
+        std::vector<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const WatchedFile& file : files) {
+                paths.push_back(file.path);
+            }
+        }
+        for (const std::string& path : paths) {
+            std::error_code error;
+            auto now = std::filesystem::last_write_time(path, error);
+            auto known = times.find(path);
+            if (known == times.end()) {
+                times[path] = now; // first look, nothing changed yet
+            } else if (known->second != now) {
+                known->second = now;
+                readSource(path);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    }
+}
+#endif
+
+static bool hasExtension(const char* name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++) {
+        const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, (unsigned int) i);
+        if (extension != NULL && std::strcmp(extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static unsigned int compileShader(GLenum type, const std::string& source)
+{
+    const char* text = source.c_str();
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// print the compile log of a shader that failed
+static void reportShader(unsigned int shader, const char* stage)
+{
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+}
+
+unsigned int loadComputeProgram(const std::string& path)
+{
+    std::string source;
+    if (!readTextFile(path, source)) {
+        std::cout << "ERROR::SHADER::FILE_NOT_READ" << std::endl;
+        return 0;
+    }
+    unsigned int shader = compileShader(GL_COMPUTE_SHADER, source);
+    reportShader(shader, "COMPUTE");
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+ShaderProgram::~ShaderProgram()
+{
+    if (pending != 0) {
+        glDeleteProgram(pending);
+    }
+    if (program != 0) {
+        glDeleteProgram(program);
+    }
+}
+
+bool ShaderProgram::load(const std::string& vertex_path, const std::string& fragment_path)
+{
+    this->vertex_path = vertex_path;
+    this->fragment_path = fragment_path;
+    parallel_compile = hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile");
+
+    // binaries only make sense for the exact driver that produced them
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    binary_cache = formats > 0 && !cache_directory.empty();
+    driver = std::string((const char*) glGetString(GL_RENDERER)) + "\n" + (const char*) glGetString(GL_VERSION);
+
+    if (!readTextFile(vertex_path, vertex_source) || !readTextFile(fragment_path, fragment_source)) {
+        std::cout << "ERROR::SHADER::FILE_NOT_READ" << std::endl;
+        return false;
+    }
+    unsigned int candidate = startBuild(vertex_source, fragment_source);
+    if (!finishBuild(candidate)) {
+        return false;
+    }
+    program = candidate;
+    return true;
+}
+
+void ShaderProgram::rebuild(const std::string& vertex_source, const std::string& fragment_source)
+{
+    // newer edits replace a build that has not finished yet
+    if (pending != 0) {
+        glDeleteProgram(pending);
+    }
+    this->vertex_source = vertex_source;
+    this->fragment_source = fragment_source;
+    pending = startBuild(this->vertex_source, this->fragment_source);
+}
+
+std::string ShaderProgram::cachePath(const std::string& vertex_source, const std::string& fragment_source) const
+{
+    std::uint64_t key = hashString(fnv_offset, driver);
+    key = hashString(key, vertex_source);
+    key = hashString(key, fragment_source);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+    return (std::filesystem::path(cache_directory) / name).string();
+}
+
+// cache files are the binary format followed by the driver's blob
+unsigned int ShaderProgram::loadBinary(const std::string& path) const
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+    std::uint32_t format = 0;
+    if (!file.read(reinterpret_cast<char*>(&format), sizeof(format))) {
+        return 0;
+    }
+    std::vector<char> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (blob.empty()) {
+        return 0;
+    }
+
+    unsigned int candidate = glCreateProgram();
+    glProgramBinary(candidate, format, blob.data(), (int) blob.size());
+    int success = 0;
+    glGetProgramiv(candidate, GL_LINK_STATUS, &success);
+    if (!success) {
+        // driver update or a different gpu, just build from source again
+        glDeleteProgram(candidate);
+        return 0;
+    }
+    return candidate;
+}
+
+void ShaderProgram::saveBinary(unsigned int candidate, const std::string& path) const
+{
+    int length = 0;
+    glGetProgramiv(candidate, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> blob((std::size_t) length);
+    GLenum format = 0;
+    glGetProgramBinary(candidate, length, NULL, &format, blob.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::uint32_t stored_format = format;
+    file.write(reinterpret_cast<const char*>(&stored_format), sizeof(stored_format));
+    file.write(blob.data(), (std::streamsize) blob.size());
+}
+
+unsigned int ShaderProgram::startBuild(const std::string& vertex_source, const std::string& fragment_source)
+{
+    pending_cache_path.clear();
+    if (binary_cache) {
+        std::string path = cachePath(vertex_source, fragment_source);
+        unsigned int cached = loadBinary(path);
+        if (cached != 0) {
+            return cached;
+        }
+        pending_cache_path = path;
+    }
+
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertex_source);
+    unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragment_source);
+
+    // link all of our shaders, with parallel compile this returns straight away
+    unsigned int candidate = glCreateProgram();
+    glAttachShader(candidate, vertexShader);
+    glAttachShader(candidate, fragmentShader);
+    if (binary_cache) {
+        glProgramParameteri(candidate, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(candidate);
+
+    // flagged for deletion, they go away with the program
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return candidate;
+}
+
+bool ShaderProgram::buildDone(unsigned int candidate) const
+{
+    if (!parallel_compile) {
+        return true; // the link status query will simply block
+    }
+    int done = 0;
+    glGetProgramiv(candidate, GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
+}
+
+bool ShaderProgram::finishBuild(unsigned int candidate)
+{
+    int success;
+    glGetProgramiv(candidate, GL_LINK_STATUS, &success);
+    if (success) {
+        if (!pending_cache_path.empty()) {
+            saveBinary(candidate, pending_cache_path);
+        }
+        return true;
+    }
+
+    // the shaders are still attached, so their logs are still there
+    unsigned int shaders[2];
+    int count = 0;
+    glGetAttachedShaders(candidate, 2, &count, shaders);
+    for (int i = 0; i < count; i++) {
+        int type;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        reportShader(shaders[i], type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT");
+    }
+    char infoLog[512];
+    glGetProgramInfoLog(candidate, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    glDeleteProgram(candidate);
+    return false;
+}
+
+bool ShaderProgram::update()
+{
+    if (pending == 0 || !buildDone(pending)) {
+        return false;
+    }
+    unsigned int candidate = pending;
+    pending = 0;
+    if (!finishBuild(candidate)) {
+        std::cout << "Keeping the previous shaders" << std::endl;
+        return false;
+    }
+
+    glDeleteProgram(program);
+    program = candidate;
+    std::cout << "Reloaded shaders" << std::endl;
+    return true;
+}
+
+ShaderProgram* ShaderLibrary::load(const std::string& vertex_path, const std::string& fragment_path)
+{
+    std::string key = vertex_path + "\n" + fragment_path;
+    auto found = programs.find(key);
+    if (found != programs.end()) {
+        return found->second.get();
+    }
+
+    std::unique_ptr<ShaderProgram> program = std::make_unique<ShaderProgram>();
+    program->setCacheDirectory(cache_directory);
+    if (!program->load(vertex_path, fragment_path)) {
+        return nullptr;
+    }
+    if (watching) {
+        watcher.add(vertex_path);
+        watcher.add(fragment_path);
+    }
+    ShaderProgram* loaded = program.get();
+    programs[key] = std::move(program);
+    return loaded;
+}
+
+bool ShaderLibrary::update()
+{
+    // an edit to a shared file, like the fullscreen vertex shader, rebuilds every program using it
+    std::map<std::string, std::string> sources;
+    if (watcher.takeChanges(sources)) {
+        for (auto& program : programs) {
+            ShaderProgram& p = *program.second;
+            auto vertex = sources.find(p.getVertexPath());
+            auto fragment = sources.find(p.getFragmentPath());
+            if (vertex != sources.end() || fragment != sources.end()) {
+                p.rebuild(vertex != sources.end() ? vertex->second : p.getVertexSource(),
+                          fragment != sources.end() ? fragment->second : p.getFragmentSource());
+            }
+        }
+    }
+
+    bool changed = false;
+    for (auto& program : programs) {
+        changed = program.second->update() || changed;
+    }
+    return changed;
+}
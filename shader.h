@@ -0,0 +1,137 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// whole file into a string, false if it could not be opened
+bool readTextFile(const std::string& path, std::string& text);
+
+// a compute program from a single file, 0 (after printing why) if it fails;
+// these are not watched or cached, they are not something to edit live
+unsigned int loadComputeProgram(const std::string& path);
+
+// waits for changes to shader files on one thread and reads the new sources
+// there, inotify on linux and mtime polling elsewhere; one watcher serves every
+// program, however many files or directories they come from
+class ShaderWatcher
+{
+public:
+    ~ShaderWatcher() { stop(); }
+
+    // watch one more file, the thread starts with the first one
+    void add(const std::string& path);
+    void stop();
+
+    // fresh sources of every file that changed since last time, by path
+    bool takeChanges(std::map<std::string, std::string>& sources);
+
+private:
+    struct WatchedFile
+    {
+        std::string path;
+        std::string directory;
+        std::string name;
+    };
+
+    void run();
+    void readSource(const std::string& path);
+
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+
+    std::mutex mutex;
+    std::vector<WatchedFile> files;
+    std::map<std::string, std::string> changed;
+#ifdef __linux__
+    int fd = -1;
+    std::map<int, std::string> directories; // inotify watch to the directory it is on
+#endif
+};
+
+// a vertex + fragment program that can be rebuilt from disk while running
+// rebuilds link in the background where the driver supports parallel
+// shader compilation and only replace the program once they link
+class ShaderProgram
+{
+public:
+    ~ShaderProgram();
+
+    // keep linked program binaries here, keyed by source and driver
+    // an empty directory turns the cache off
+    void setCacheDirectory(const std::string& directory) { cache_directory = directory; }
+
+    // blocking first build, false if it fails to compile or link
+    bool load(const std::string& vertex_path, const std::string& fragment_path);
+
+    const std::string& getVertexPath() const { return vertex_path; }
+    const std::string& getFragmentPath() const { return fragment_path; }
+
+    // start building from new sources, it replaces the program once it links
+    // a rebuild still in progress is dropped
+    void rebuild(const std::string& vertex_source, const std::string& fragment_source);
+
+    // the sources of the newest build, so an edit to one file can reuse the other
+    const std::string& getVertexSource() const { return vertex_source; }
+    const std::string& getFragmentSource() const { return fragment_source; }
+
+    // call once a frame, returns true when a rebuilt program was swapped in
+    // (uniforms have to be set again then)
+    bool update();
+
+    unsigned int getId() const { return program; }
+
+private:
+    // load from the binary cache, or compile and start linking, the result is
+    // checked later by finishBuild
+    unsigned int startBuild(const std::string& vertex_source, const std::string& fragment_source);
+    std::string cachePath(const std::string& vertex_source, const std::string& fragment_source) const;
+    unsigned int loadBinary(const std::string& path) const;
+    void saveBinary(unsigned int candidate, const std::string& path) const;
+    bool buildDone(unsigned int candidate) const;
+    bool finishBuild(unsigned int candidate);
+
+    std::string vertex_path;
+    std::string fragment_path;
+    unsigned int program = 0;
+    unsigned int pending = 0; // program still linking
+    std::string pending_cache_path; // where pending goes once linked, empty if it came from there
+    bool parallel_compile = false;
+    bool binary_cache = false; // the driver can hand out program binaries at all
+    std::string cache_directory = "shader_cache";
+    std::string driver; // renderer and version, part of every cache key
+    std::string vertex_source;
+    std::string fragment_source;
+};
+
+// every program the visuals use, loaded once by file names and rebuilt together
+class ShaderLibrary
+{
+public:
+    void setCacheDirectory(const std::string& directory) { cache_directory = directory; }
+
+    // watch the files of every program loaded from now on
+    void setWatching(bool watching) { this->watching = watching; }
+
+    // the program built from these files, loading it on first use, null if it fails to build
+    ShaderProgram* load(const std::string& vertex_path, const std::string& fragment_path);
+
+    // call once a frame, rebuilds every program using a file that changed
+    // and returns true if any program was swapped
+    bool update();
+
+private:
+    std::map<std::string, std::unique_ptr<ShaderProgram>> programs;
+    ShaderWatcher watcher;
+    std::string cache_directory = "shader_cache";
+    bool watching = false;
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "spectrum.h"
+#include "decimate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const double pi = 3.14159265358979323846;
+
+bool isValidFFTSize(std::size_t size)
+{
+    return size >= 512 && size <= 8192 && (size & (size - 1)) == 0;
+}
+
+RealFFT::RealFFT(std::size_t size)
+    : n(size), m(size / 2)
+{
+    bitrev.reserve(m);
+    bitrev.resize(m);
+    std::size_t bits = 0;
+    while (((std::size_t) 1 << bits) < m) {
+        bits++;
+    }
+    for (std::size_t i = 0; i < m; i++) {
+        std::uint32_t r = 0;
+        for (std::size_t b = 0; b < bits; b++) {
+            r |= (std::uint32_t) ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitrev[i] = r;
+    }
+
+    twiddle_re.reserve(m / 2);
+    twiddle_re.resize(m / 2);
+    twiddle_im.reserve(m / 2);
+    twiddle_im.resize(m / 2);
+    for (std::size_t k = 0; k < m / 2; k++) {
+        twiddle_re[k] = (float) std::cos(-2.0 * pi * (double) k / (double) m);
+        twiddle_im[k] = (float) std::sin(-2.0 * pi * (double) k / (double) m);
+    }
+
+    split_re.reserve(m);
+    split_re.resize(m);
+    split_im.reserve(m);
+    split_im.resize(m);
+    for (std::size_t k = 0; k < m; k++) {
+        split_re[k] = (float) std::cos(-2.0 * pi * (double) k / (double) n);
+        split_im[k] = (float) std::sin(-2.0 * pi * (double) k / (double) n);
+    }
+
+    re.reserve(m);
+    re.resize(m);
+    im.reserve(m);
+    im.resize(m);
+}
+
+void RealFFT::transform()
+{
+    for (std::size_t i = 0; i < m; i++) {
+        std::size_t j = bitrev[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    // butterflies, the twiddle stride halves every stage
+    for (std::size_t half = 1, stride = m / 2; half < m; half *= 2, stride /= 2) {
+        for (std::size_t start = 0; start < m; start += half * 2) {
+            float* a_re = &re[start];
+            float* a_im = &im[start];
+            float* b_re = &re[start + half];
+            float* b_im = &im[start + half];
+            for (std::size_t k = 0; k < half; k++) {
+                float w_re = twiddle_re[k * stride];
+                float w_im = twiddle_im[k * stride];
+                float t_re = b_re[k] * w_re - b_im[k] * w_im;
+                float t_im = b_re[k] * w_im + b_im[k] * w_re;
+                b_re[k] = a_re[k] - t_re;
+                b_im[k] = a_im[k] - t_im;
+                a_re[k] += t_re;
+                a_im[k] += t_im;
+            }
+        }
+    }
+}
+
+void RealFFT::powerSpectrum(const float* input, float* power)
+{
+    // pack even samples as real and odd samples as imaginary parts
+    for (std::size_t i = 0; i < m; i++) {
+        re[i] = input[i * 2];
+        im[i] = input[i * 2 + 1];
+    }
+    transform();
+
+    // split the half size result back into the spectrum of the real signal
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[m] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (std::size_t k = 1; k < m; k++) {
+        float z_re = re[k], z_im = im[k];
+        float c_re = re[m - k], c_im = -im[m - k]; // conj(Z[m - k])
+        float even_re = 0.5f * (z_re + c_re);
+        float even_im = 0.5f * (z_im + c_im);
+        float odd_re = 0.5f * (z_im - c_im); // (Z[k] - conj(Z[m - k])) / 2i
+        float odd_im = -0.5f * (z_re - c_re);
+        float x_re = even_re + split_re[k] * odd_re - split_im[k] * odd_im;
+        float x_im = even_im + split_re[k] * odd_im + split_im[k] * odd_re;
+        power[k] = x_re * x_re + x_im * x_im;
+    }
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(const SpectrumSettings& settings, unsigned int sample_rate)
+    : settings(settings), fft(settings.fft_size)
+{
+    std::size_t n = settings.fft_size;
+    std::size_t bins = n / 2 + 1;
+
+    // hann window, and the scale that maps the energy of a full scale sine to 0 db
+    window.reserve(n);
+    window.resize(n);
+    double window_energy = 0.0;
+    for (std::size_t i = 0; i < n; i++) {
+        window[i] = (float) (0.5 - 0.5 * std::cos(2.0 * pi * (double) i / (double) n));
+        window_energy += (double) window[i] * window[i];
+    }
+    power_scale = (float) (4.0 / ((double) n * window_energy));
+    windowed.reserve(n);
+    windowed.resize(n);
+    power.reserve(bins);
+    power.resize(bins);
+
+    bands.reserve(settings.bands);
+    bands.resize(settings.bands);
+    std::fill(bands.begin(), bands.end(), 0.0f);
+
+    // log spaced band edges from min_freq up to nyquist
+    band_first.reserve(settings.bands);
+    band_first.resize(settings.bands);
+    band_last.reserve(settings.bands);
+    band_last.resize(settings.bands);
+    band_centre.reserve(settings.bands);
+    band_centre.resize(settings.bands);
+    double nyquist = sample_rate / 2.0;
+    double min_freq = std::min((double) settings.min_freq, nyquist / 2.0);
+    double bin_hz = (double) sample_rate / (double) n;
+    for (std::size_t b = 0; b < settings.bands; b++) {
+        double lo = min_freq * std::pow(nyquist / min_freq, (double) b / (double) settings.bands);
+        double hi = min_freq * std::pow(nyquist / min_freq, (double) (b + 1) / (double) settings.bands);
+        std::size_t first = (std::size_t) std::ceil(lo / bin_hz);
+        std::size_t last = std::min((std::size_t) std::floor(hi / bin_hz), bins - 1);
+        band_first[b] = (std::uint32_t) first;
+        band_last[b] = (std::uint32_t) last;
+        band_centre[b] = (float) (std::sqrt(lo * hi) / bin_hz);
+    }
+}
+
+void SpectrumAnalyzer::analyze(const float* mono)
+{
+    std::size_t n = settings.fft_size;
+    for (std::size_t i = 0; i < n; i++) {
+        windowed[i] = mono[i] * window[i];
+    }
+    fft.powerSpectrum(windowed.data(), power.data());
+
+    std::size_t bins = n / 2 + 1;
+    for (std::size_t b = 0; b < bands.size(); b++) {
+        float p;
+        if (band_first[b] <= band_last[b]) {
+            p = 0.0f;
+            for (std::uint32_t k = band_first[b]; k <= band_last[b]; k++) {
+                p += power[k];
+            }
+        } else {
+            // band narrower than a bin, interpolate between the two around it
+            float c = std::min(band_centre[b], (float) (bins - 1));
+            std::size_t k = std::min((std::size_t) c, bins - 2);
+            float t = c - (float) k;
+            p = power[k] + (power[k + 1] - power[k]) * t;
+        }
+
+        // -80 db to 0 db maps onto [0, 1]
+        float db = 10.0f * std::log10(p * power_scale + 1e-12f);
+        float level = std::min(std::max((db + 80.0f) / 80.0f, 0.0f), 1.0f);
+
+        bands[b] = smoothBand(bands[b], level, settings.smoothing);
+    }
+}
+
+Spectrum::Spectrum(AudioStream& stream, const SpectrumSettings& settings)
+    : stream(stream), analyzer(settings, stream.getSampleRate())
+{
+    raw_samples.reserve(settings.fft_size * stream.getChannelCount());
+    raw_samples.resize(settings.fft_size * stream.getChannelCount());
+    mono.reserve(settings.fft_size);
+    mono.resize(settings.fft_size);
+}
+
+bool Spectrum::update(double seconds)
+{
+    const SpectrumSettings& settings = analyzer.getSettings();
+    long long frame = (long long) (seconds * stream.getSampleRate());
+    if (last_frame >= 0 && std::llabs(frame - last_frame) < (long long) settings.hop) {
+        return false;
+    }
+    analyzeFrame(frame);
+    return true;
+}
+
+void Spectrum::analyzeFrame(long long frame)
+{
+    const SpectrumSettings& settings = analyzer.getSettings();
+    last_frame = frame;
+
+    readMonoWindow(stream, frame, settings.fft_size, raw_samples.data(), mono.data());
+    analyzer.analyze(mono.data());
+}
+
+void readMonoWindow(AudioStream& stream, long long frame, std::size_t size, sf::Int16* raw, float* mono)
+{
+    // zero pad whatever part of the window falls outside the track
+    unsigned int channels = stream.getChannelCount();
+    long long first = frame - (long long) size / 2;
+    std::size_t skip = (std::size_t) std::max(-first, 0ll);
+    std::size_t frames = size - std::min(skip, size);
+    std::memset(raw, 0, size * channels * sizeof(sf::Int16));
+    if (frames > 0) {
+        stream.read((sf::Uint64) (first + (long long) skip) * channels, raw + skip * channels, frames * channels);
+    }
+    mixToMono(raw, size, channels, mono);
+}
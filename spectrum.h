@@ -0,0 +1,131 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "analysis_buffer.h"
+#include "audio_stream.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// iterative radix-2 fft of real input, done as a half size complex fft
+// plus a split step, with all tables computed up front
+class RealFFT
+{
+public:
+    // size must be a power of two, at least 4
+    explicit RealFFT(std::size_t size);
+
+    std::size_t size() const { return n; }
+
+    // |X[k]|^2 for k = 0 .. size / 2 of size real samples
+    void powerSpectrum(const float* input, float* power);
+
+private:
+    // in place complex fft of re/im, length m
+    void transform();
+
+    std::size_t n;
+    std::size_t m;
+    AnalysisBuffer<std::uint32_t> bitrev;
+    AnalysisBuffer<float> twiddle_re; // e^(-2 pi i k / m), k < m / 2
+    AnalysisBuffer<float> twiddle_im;
+    AnalysisBuffer<float> split_re; // e^(-2 pi i k / n), k < m
+    AnalysisBuffer<float> split_im;
+    AnalysisBuffer<float> re;
+    AnalysisBuffer<float> im;
+};
+
+struct SpectrumSettings
+{
+    std::size_t fft_size = 2048; // power of two, 512 to 8192
+    std::size_t hop = 512; // frames between analyses
+    std::size_t bands = 64; // log spaced output bands
+    float min_freq = 30.0f; // lowest band edge in hz
+    float smoothing = 0.85f; // how slowly bands fall back, 0 is no smoothing
+};
+
+// one step of the band smoothing: rise instantly, fall back slowly
+// shared so an offline pass can apply it later and get the exact same bands
+inline float smoothBand(float current, float level, float smoothing)
+{
+    return level >= current ? level : level + (current - level) * smoothing;
+}
+
+// windowed fft reduced to smoothed log-frequency bands in [0, 1]
+class SpectrumAnalyzer
+{
+public:
+    SpectrumAnalyzer(const SpectrumSettings& settings, unsigned int sample_rate);
+
+    const SpectrumSettings& getSettings() const { return settings; }
+
+    // analyse fft_size mono samples and fold the result into the bands
+    void analyze(const float* mono);
+
+    const float* getBands() const { return bands.data(); }
+    std::size_t getBandCount() const { return bands.size(); }
+
+    // the band layout, for other backends doing the same analysis
+    const std::uint32_t* getBandFirst() const { return band_first.data(); }
+    const std::uint32_t* getBandLast() const { return band_last.data(); }
+    const float* getBandCentre() const { return band_centre.data(); }
+    float getPowerScale() const { return power_scale; }
+
+private:
+    SpectrumSettings settings;
+    RealFFT fft;
+    AnalysisBuffer<float> window;
+    AnalysisBuffer<float> windowed;
+    AnalysisBuffer<float> power;
+    AnalysisBuffer<float> bands;
+
+    // power bins covered by each band, narrow low bands just interpolate at their centre
+    AnalysisBuffer<std::uint32_t> band_first;
+    AnalysisBuffer<std::uint32_t> band_last;
+    AnalysisBuffer<float> band_centre;
+    float power_scale;
+};
+
+// anything that can produce the spectrum bands for a point in time
+class SpectrumSource
+{
+public:
+    virtual ~SpectrumSource() {}
+
+    // move to the given time, returns true if the bands changed
+    virtual bool update(double seconds) = 0;
+
+    virtual const float* getBands() const = 0;
+    virtual std::size_t getBandCount() const = 0;
+};
+
+// runs a spectrum analyzer over a streamed track, one analysis per hop
+class Spectrum : public SpectrumSource
+{
+public:
+    Spectrum(AudioStream& stream, const SpectrumSettings& settings);
+
+    // analyses the window centred on the given time if we have moved at least one hop
+    bool update(double seconds) override;
+
+    // analyse the window centred on the given frame unconditionally
+    void analyzeFrame(long long frame);
+
+    const float* getBands() const override { return analyzer.getBands(); }
+    std::size_t getBandCount() const override { return analyzer.getBandCount(); }
+
+private:
+    AudioStream& stream;
+    SpectrumAnalyzer analyzer;
+    AnalysisBuffer<sf::Int16> raw_samples;
+    AnalysisBuffer<float> mono;
+    long long last_frame = -1;
+};
+
+// mono mix of the size frames centred on frame, zero padded outside the track;
+// raw needs room for size * channels samples
+void readMonoWindow(AudioStream& stream, long long frame, std::size_t size, sf::Int16* raw, float* mono);
+
+bool isValidFFTSize(std::size_t size);
+
+#endif
@@ -0,0 +1,31 @@
+#include "spectrum_bars.h"
+
+bool SpectrumBars::create(std::size_t bar_count)
+{
+    destroy();
+    this->bar_count = bar_count;
+
+    // no vertex data at all, but core profile still wants some vao bound
+    glGenVertexArrays(1, &empty_vao);
+    return true;
+}
+
+void SpectrumBars::destroy()
+{
+    if (empty_vao != 0) {
+        glDeleteVertexArrays(1, &empty_vao);
+        empty_vao = 0;
+    }
+}
+
+void SpectrumBars::setUniforms(unsigned int program) const
+{
+    glUniform1i(glGetUniformLocation(program, "bar_count"), (int) bar_count);
+}
+
+void SpectrumBars::draw(GLState& state) const
+{
+    state.polygonMode(GL_FILL);
+    state.bindVertexArray(empty_vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (int) bar_count);
+}
@@ -0,0 +1,38 @@
+#ifndef SPECTRUM_BARS_H
+#define SPECTRUM_BARS_H
+
+#include "gl_state.h"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// a row of bars, one instance each; the vertex shader builds the quad from
+// gl_VertexID and reads its height from the spectrum texture, so nothing per
+// bar is ever written by the cpu and a frame costs the same for any count
+class SpectrumBars
+{
+public:
+    SpectrumBars() {}
+    ~SpectrumBars() { destroy(); }
+
+    SpectrumBars(const SpectrumBars&) = delete;
+    SpectrumBars& operator=(const SpectrumBars&) = delete;
+
+    bool create(std::size_t bar_count);
+    void destroy();
+
+    // sets the bar count on the bound program, for a pass setup
+    void setUniforms(unsigned int program) const;
+
+    // one instanced draw for every bar
+    void draw(GLState& state) const;
+
+    std::size_t getBarCount() const { return bar_count; }
+
+private:
+    std::size_t bar_count = 0;
+    unsigned int empty_vao = 0;
+};
+
+#endif
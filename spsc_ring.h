@@ -0,0 +1,125 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "analysis_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+// wait-free ring for exactly one producer thread and one consumer thread,
+// for pcm blocks and feature frames going between the audio, analysis and
+// render threads; no call ever blocks or retries, a full ring just takes less
+// capacity is rounded up to a power of two, indices only ever grow and wrap
+// through a mask, so full and empty are never confused
+template <typename T>
+class SpscRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing copies items with memcpy");
+
+public:
+    explicit SpscRing(std::size_t capacity)
+    {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        items.reserve(size);
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    std::size_t capacity() const { return items.size(); }
+
+    // producer side, copies as many as fit and returns how many that was
+    std::size_t push(const T* data, std::size_t count)
+    {
+        std::size_t write = producer.index.load(std::memory_order_relaxed);
+        count = std::min(count, room(write, count));
+        copyIn(write, data, count);
+        producer.index.store(write + count, std::memory_order_release);
+        return count;
+    }
+
+    // producer side, one item, false if the ring is full
+    bool tryPush(const T& item) { return push(&item, 1) == 1; }
+
+    // producer side, how many items push would take right now
+    std::size_t writable() { return room(producer.index.load(std::memory_order_relaxed), items.size()); }
+
+    // consumer side, copies out up to count and returns how many that was
+    std::size_t pop(T* out, std::size_t count)
+    {
+        std::size_t read = consumer.index.load(std::memory_order_relaxed);
+        count = std::min(count, waiting(read, count));
+        copyOut(read, out, count);
+        consumer.index.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // consumer side, one item, false if the ring is empty
+    bool tryPop(T& item) { return pop(&item, 1) == 1; }
+
+    // consumer side, how many items pop would give right now
+    std::size_t readable() { return waiting(consumer.index.load(std::memory_order_relaxed), items.size()); }
+
+private:
+    // each side keeps the last index it saw of the other side and only reloads
+    // it when that copy says there is not enough, so in the steady state
+    // neither side touches the other's cache line
+    std::size_t room(std::size_t write, std::size_t wanted)
+    {
+        std::size_t free = items.size() - (write - producer.cached_other);
+        if (free < wanted) {
+            producer.cached_other = consumer.index.load(std::memory_order_acquire);
+            free = items.size() - (write - producer.cached_other);
+        }
+        return free;
+    }
+
+    std::size_t waiting(std::size_t read, std::size_t wanted)
+    {
+        std::size_t count = consumer.cached_other - read;
+        if (count < wanted) {
+            consumer.cached_other = producer.index.load(std::memory_order_acquire);
+            count = consumer.cached_other - read;
+        }
+        return count;
+    }
+
+    // a run may wrap past the end of the storage, so copy it in two parts
+    void copyIn(std::size_t index, const T* data, std::size_t count)
+    {
+        std::size_t start = index & mask;
+        std::size_t first = std::min(count, items.size() - start);
+        std::memcpy(&items[start], data, first * sizeof(T));
+        std::memcpy(&items[0], data + first, (count - first) * sizeof(T));
+    }
+
+    void copyOut(std::size_t index, T* out, std::size_t count) const
+    {
+        std::size_t start = index & mask;
+        std::size_t first = std::min(count, items.size() - start);
+        std::memcpy(out, &items[start], first * sizeof(T));
+        std::memcpy(out + first, &items[0], (count - first) * sizeof(T));
+    }
+
+    // one cache line per side, so the two threads never false share
+    struct alignas(64) Side
+    {
+        std::atomic<std::size_t> index{0};
+        std::size_t cached_other = 0; // the other side's index, as last seen
+    };
+
+    AnalysisBuffer<T> items;
+    std::size_t mask = 0;
+    Side producer;
+    Side consumer;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "stream_buffer.h"
+
+#include <iostream>
+
+bool StreamBuffer::create(std::size_t frame_bytes)
+{
+    destroy();
+
+    // keep regions aligned so every allocation can start on a boundary
+    region_bytes = (frame_bytes + 255) & ~(std::size_t) 255;
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr) (region_bytes * ring_size), NULL, flags);
+    mapped = (unsigned char*) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr) (region_bytes * ring_size), flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (mapped == nullptr) {
+        std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+        destroy();
+        return false;
+    }
+
+    // start on the last region so the first beginFrame lands on region 0
+    region = ring_size - 1;
+    used = region_bytes;
+    return true;
+}
+
+void StreamBuffer::destroy()
+{
+    for (std::size_t i = 0; i < ring_size; i++) {
+        if (fences[i] != nullptr) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    if (buffer != 0) {
+        // unmapping a persistent buffer is allowed, deleting does it anyway
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    mapped = nullptr;
+}
+
+void StreamBuffer::beginFrame()
+{
+    region = (region + 1) % ring_size;
+    used = 0;
+    if (fences[region] == nullptr) {
+        return;
+    }
+
+    // issued ring_size - 1 frames ago, so normally already signalled
+    glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fences[region]);
+    fences[region] = nullptr;
+}
+
+void* StreamBuffer::allocate(std::size_t bytes, std::size_t& offset, std::size_t alignment)
+{
+    std::size_t start = (used + alignment - 1) / alignment * alignment;
+    if (mapped == nullptr || start + bytes > region_bytes) {
+        return nullptr;
+    }
+    used = start + bytes;
+    offset = region * region_bytes + start;
+    return mapped + offset;
+}
+
+void StreamBuffer::endFrame()
+{
+    if (mapped == nullptr || used == 0) {
+        return;
+    }
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,47 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// a buffer that stays mapped for its whole life, split into one region per
+// frame in flight; the cpu writes the current region while the gpu reads the
+// older ones, and a fence per region says when it can be written again
+class StreamBuffer
+{
+public:
+    StreamBuffer() {}
+    ~StreamBuffer() { destroy(); }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // frame_bytes is the most a single frame will allocate
+    bool create(std::size_t frame_bytes);
+    void destroy();
+
+    // move to the next region, only blocks if the gpu is still reading it
+    void beginFrame();
+
+    // space for this frame's data, offset is where it starts in the buffer;
+    // null if the region is full
+    void* allocate(std::size_t bytes, std::size_t& offset, std::size_t alignment = 256);
+
+    // fence the region once every command reading it has been issued
+    void endFrame();
+
+    unsigned int getId() const { return buffer; }
+
+private:
+    static const std::size_t ring_size = 3;
+
+    unsigned int buffer = 0;
+    unsigned char* mapped = nullptr;
+    std::size_t region_bytes = 0;
+    std::size_t region = 0;
+    std::size_t used = 0;
+    GLsync fences[ring_size] = {nullptr, nullptr, nullptr};
+};
+
+#endif
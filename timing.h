@@ -0,0 +1,69 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <algorithm>
+
+// maps wall-clock time onto the audio timeline, so the visuals run at the
+// same speed whatever the frame rate is
+class AudioClock
+{
+public:
+    // call once when playback starts
+    void start(double now)
+    {
+        start_time = now;
+        last_frame = now;
+        frame_time = 0.0;
+    }
+
+    // offline rendering, time moves exactly one step per frame whatever the wall clock says
+    void startFixed(double step)
+    {
+        start(0.0);
+        fixed_step = step;
+        frame_index = -1;
+    }
+
+    // call at the top of every frame, keeps a smoothed estimate of the frame time
+    void frameStarted(double now)
+    {
+        if (fixed_step > 0.0) {
+            frame_index++;
+            return;
+        }
+        double dt = std::max(now - last_frame, 0.0);
+        frame_time = (frame_time == 0.0) ? dt : frame_time + (dt - frame_time) * 0.1;
+        last_frame = now;
+    }
+
+    // nudge the timeline towards the audio device clock, which is accurate over a
+    // whole track but only updates once per audio buffer, so small errors are
+    // slewed out gradually and only big jumps (underruns, seeks) are snapped
+    void sync(double now, double audio_seconds)
+    {
+        double error = audio_seconds - seconds(now);
+        if (error > 0.1 || error < -0.1) {
+            start_time -= error;
+        } else {
+            start_time -= error * 0.05;
+        }
+    }
+
+    // seconds of audio played at wall-clock time now
+    double seconds(double now) const
+    {
+        return (fixed_step > 0.0) ? (double) frame_index * fixed_step : now - start_time;
+    }
+
+    // the frame drawn now shows up about one frame later, aim for that moment
+    double presentationSeconds(double now) const { return seconds(now) + frame_time; }
+
+private:
+    double start_time = 0.0;
+    double last_frame = 0.0;
+    double frame_time = 0.0;
+    double fixed_step = 0.0;
+    long long frame_index = 0;
+};
+
+#endif
@@ -1,7 +1,20 @@
 #version 460 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec2 aPos;
+
+// per instance, from the geometry batch
+layout (location = 1) in vec4 placement; // centre xy, half size zw
+layout (location = 2) in float rotation;
+layout (location = 3) in vec4 colour;
+
+out float bandPos;
+out vec4 tint;
 
 void main()
 {
-    gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
+    vec2 scaled = aPos * placement.zw;
+    float c = cos(rotation), s = sin(rotation);
+    vec2 position = placement.xy + vec2(c * scaled.x - s * scaled.y, s * scaled.x + c * scaled.y);
+    gl_Position = vec4(position, 0.0, 1.0);
+    bandPos = position.x * 0.5 + 0.5; // left edge is bass, right edge is treble
+    tint = colour;
 }
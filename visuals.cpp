@@ -2,206 +2,444 @@
 #include <GLFW/glfw3.h>
 #include <SFML/Audio.hpp>
 
+#include "analysis_thread.h"
+#include "audio_stream.h"
+#include "capture.h"
+#include "context.h"
+#include "decimate.h"
+#include "envelope.h"
+#include "envelope_pyramid.h"
+#include "export.h"
+#include "feature_cache.h"
+#include "framebuffer.h"
+#include "geometry_batch.h"
+#include "gl_state.h"
+#include "gpu_spectrum.h"
+#include "normalizer.h"
+#include "options.h"
+#include "profiler.h"
+#include "render_graph.h"
+#include "shader.h"
+#include "spectrum.h"
+#include "spectrum_bars.h"
+#include "stream_buffer.h"
+#include "timing.h"
+
+#include <cmath>
+#include <cstring>
 #include <iostream>
-#include <sstream>
-#include <fstream>
+#include <limits>
+#include <memory>
+#include <vector>
 
 // register other functions
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window);
+bool buildVisual(const Options& options, RenderGraph& graph, ShaderLibrary& shaders, GLState& state,
+                 SpectrumBars& bars, const unsigned int& waveform_texture, const float& playhead, RenderPass scene);
 
 int main(int argc, char *argv[]) // name of audio file
 {
-    if (argc != 2) {
-        printf("No audio file provided");
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
         exit(0);
     }
 
-    // init the glsl context
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-// macos specific config
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-    // get the desktop resolution
-    int win_width, win_height;
-    const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-    win_width = mode->width;
-    win_height = mode->height;
-
-    // create the glfw window
-    GLFWwindow* window = glfwCreateWindow(win_width, win_height, "visuals", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    // frames streamed to stdout must be the only thing on it, so every status
+    // line from here on goes to stderr
+    if (options.exporting && options.export_settings.target == "-" && !claimStdout()) {
+        std::cerr << "Failed to claim stdout for the frames" << std::endl;
         return -1;
     }
-    glfwMakeContextCurrent(window);
 
-    // init glad to load opengl func ptr addresses
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+    // init the glsl context, on screen or off
+    GLContext context;
+    if (options.headless) {
+        if (!context.createHeadless(options.width, options.height)) {
+            return -1;
+        }
+    } else if (!context.createWindow("visuals")) {
         return -1;
     }
+    GLFWwindow* window = context.getWindow();
 
-    // set size of rendering window
-    glViewport(0, 0, win_width, win_height);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);  
-
-    // basic vertex shader
-    std::ostringstream sstream;
-    std::ifstream fs("vertexShaderSource.vert");
-    sstream << fs.rdbuf();
-    const std::string str(sstream.str());
-    const char* vertexShaderSource = str.c_str();
-
-    // compile vertex shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-
-    // basic fragment shader
-    std::ostringstream sstream2;
-    std::ifstream fs2("fragmentShaderSource.frag");
-    sstream2 << fs2.rdbuf();
-    const std::string str2(sstream2.str());
-    const char* fragmentShaderSource = str2.c_str();
-
-    // compile fragment shader
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    // link all of our shaders
-    unsigned int shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // delete shaders after linking them
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);  
-
-    // input vertex data
-    float vertices[] = {
-        -0.5303f, -0.5303f, 0.0000f,
-        0.5303f, -0.5303f, 0.0000f,
-        0.0000f,  0.7500f, 0.0000f
-    };
-
-    // opengl object (vertex buffer object)
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-
-    // draw vao object (vertex array object)
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);  
+    // headless frames go into an fbo at the requested resolution
+    Framebuffer offscreen;
+    if (context.isHeadless()) {
+        if (!offscreen.create(context.getWidth(), context.getHeight())) {
+            return -1;
+        }
+        offscreen.bind();
+    } else {
+        // set size of rendering window
+        glViewport(0, 0, context.getWidth(), context.getHeight());
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    }
 
-    // ebo is element buffer object
-    // stores indicies opengl uses to draw
+    // compile and link our shaders, and rebuild them whenever they are saved
+    ShaderLibrary shaders;
+    if (!options.shader_cache) {
+        shaders.setCacheDirectory("");
+    }
+    shaders.setWatching(!options.exporting);
+    ShaderProgram* shader = shaders.load("vertexShaderSource.vert", "fragmentShaderSource.frag");
+    if (shader == NULL) {
+        return -1;
+    }
 
-    // bind the vao and copy data there
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // every primitive of the scene goes into one batch, drawn with a single call
+    GLState state;
+    GeometryBatch geometry;
+    if (!geometry.create(4096)) {
+        return -1;
+    }
 
-    // bind to buffer and populate
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);  
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // stream the sound data with sfml, blocks are decoded as the loop reaches them
+    AudioStream audio_stream;
+    if (!options.capturing && !audio_stream.open(options.audio_file)) {
+        std::cout << "Failed to open audio file" << std::endl;
+        return -1;
+    }
+    if (options.bench_analysis) {
+        if (!benchmarkSpectrum(audio_stream, options.spectrum, stdout)) {
+            std::cout << "The gpu analyzer is not available" << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+    // because there are too many samples, reduce every 10 ms of audio to one value
+    FeatureParams feature_params;
+    feature_params.window_frames = std::max(1u, audio_stream.getSampleRate() / 100);
+    feature_params.spectrum = options.spectrum;
+    feature_params.spectra = options.cache_spectra;
+
+    // scales levels into brightness, the track mode needs the loudest window
+    // up front and takes it from the cache when it can
+    Normalizer normalizer(options.normalize);
+    bool have_track_peak = false;
+
+    // reuse the analysis of a previous run if there is one, otherwise
+    // analyse live and build the cache in the background for next time;
+    // the track mode needs the loudest window before the first frame, so it
+    // builds the cache up front instead and reads the peak back from there
+    FeatureCache feature_cache;
+    FeatureCacheBuilder cache_builder;
+    std::unique_ptr<EnvelopeSource> envelope;
+    std::unique_ptr<SpectrumSource> spectrum;
+    if (options.use_cache) {
+        std::uint64_t key = featureKey(options.audio_file, feature_params);
+        std::string cache_path = featureCachePath(options.audio_file);
+        bool cached = feature_cache.open(cache_path, key);
+        bool build_now = !cached && options.normalize.mode == NormalizeMode::Track;
+        if (build_now) {
+            printf("building feature cache %s\n", cache_path.c_str());
+            cached = cache_builder.build(options.audio_file, cache_path, feature_params, key)
+                     && feature_cache.open(cache_path, key);
+        }
+        if (cached) {
+            printf("using feature cache %s\n", cache_path.c_str());
+            envelope = std::make_unique<CachedEnvelope>(feature_cache);
+            normalizer.setTrackPeak(feature_cache.getHeader().rms_peak);
+            have_track_peak = true;
+            if (feature_cache.hasSpectra()) {
+                spectrum = std::make_unique<CachedSpectrum>(feature_cache);
+            }
+        } else if (!build_now) {
+            cache_builder.start(options.audio_file, cache_path, feature_params, key);
+        }
+    }
 
-    // tell opengl how to read vertex data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);  
+    // a live input is recorded on its own thread and handed over through a ring,
+    // a file can stand in for the device where there is none
+    CaptureBuffer capture_buffer(1 << 18);
+    DeviceRecorder recorder(capture_buffer);
+    FakeRecorder fake_recorder(capture_buffer);
+    LiveAnalyzer* live = nullptr;
+    double capture_chunk = 0.0;
+    if (options.capturing) {
+        bool started = options.capture_file.empty() ? recorder.open(options.capture_device, 44100, 2)
+                                                    : fake_recorder.start(options.capture_file);
+        if (!started) {
+            std::cout << "Failed to start audio capture" << std::endl;
+            return -1;
+        }
+        capture_chunk = options.capture_file.empty() ? recorder.getChunkSeconds() : fake_recorder.getChunkSeconds();
+        std::unique_ptr<LiveAnalyzer> analyzer = std::make_unique<LiveAnalyzer>(capture_buffer, options.spectrum);
+        live = analyzer.get();
+        spectrum = std::move(analyzer);
+    }
 
-    // get the sound data with sfml
-    sf::SoundBuffer sound_buffer;
-    sound_buffer.loadFromFile(argv[1]);
-    const sf::Int16* samples = sound_buffer.getSamples();
-    std::size_t count = sound_buffer.getSampleCount();
-    int proc_count = count / 1000;
-    int proc_samples[proc_count];
-    for (int i = 0; i < proc_count; i++) {
-        proc_samples[i] = samples[i * 1000];
+    if (options.normalize.mode == NormalizeMode::Track && !have_track_peak) {
+        float peak = scanTrackPeak(options.audio_file, feature_params.window_frames);
+        if (peak < 0.0f) {
+            std::cout << "Failed to scan the track for its peak" << std::endl;
+            return -1;
+        }
+        normalizer.setTrackPeak(peak);
     }
+    printf("normalizing with %s mode\n", normalizeModeName(options.normalize.mode));
 
-    // useful if sound samples are all small
-    // int min_sample = -16, max_sample = 16, current;
+    if (!envelope && !live) {
+        envelope = std::make_unique<Envelope>(audio_stream, feature_params.window_frames);
+        printf("decimating with %s kernel\n", decimateKernelName());
+    }
+    if (!spectrum) {
+        // log spaced spectrum, recomputed every hop
+        spectrum = std::make_unique<Spectrum>(audio_stream, options.spectrum);
+    }
+    const double duration = live ? std::numeric_limits<double>::infinity() : (double) envelope->size() / envelope->getRate();
+
+    // spectrum bands live in a 1d texture the shaders can sample
+    unsigned int spectrumTexture;
+    glGenTextures(1, &spectrumTexture);
+    glBindTexture(GL_TEXTURE_1D, spectrumTexture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, (int) spectrum->getBandCount(), 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    // the gpu backend fills that texture itself, the cpu one is the fallback;
+    // the analysis thread mixes its windows, this thread only uploads them
+    std::unique_ptr<GpuSpectrum> gpu_spectrum;
+    std::vector<float> gpu_window;
+    if (options.gpu_analysis && !live) {
+        gpu_spectrum = std::make_unique<GpuSpectrum>(audio_stream, options.spectrum, state);
+        if (!gpu_spectrum->create(spectrumTexture)) {
+            std::cout << "Compute spectrum unavailable, using the cpu analyzer" << std::endl;
+            gpu_spectrum.reset();
+        }
+    }
 
-    // actually process the sound data
-    // because there are too many samples, have to remove some
-    int min_sample = 2147483647, max_sample = -2147483647, current;
-    for (int i = 0; i < proc_count; i++) {
-        current = proc_samples[i];
-        if (current < min_sample) {
-            min_sample = current;
+    // the envelope and spectrum run on their own thread from here on, ahead of
+    // the render clock; exports wait for every frame so they come out the same each time
+    AnalysisThread analysis;
+    if (live) {
+        analysis.startLive(live);
+    } else {
+        double analysis_rate = std::max(100.0, (double) audio_stream.getSampleRate() / (double) options.spectrum.hop);
+        if (gpu_spectrum) {
+            gpu_window.resize(options.spectrum.fft_size);
+            analysis.produceWindows(&audio_stream, options.spectrum.fft_size, options.spectrum.hop);
         }
-        if (current > max_sample) {
-            max_sample = current;
+        analysis.start(envelope.get(), gpu_spectrum ? nullptr : spectrum.get(), analysis_rate, 0.25, !options.exporting);
+    }
+
+    // the whole track summarised at every zoom, only for the visual that draws it;
+    // it builds in the background and shows up once it is uploaded, exports
+    // wait for it so every frame has it
+    EnvelopePyramid pyramid;
+    unsigned int waveformTexture = 0;
+    float playhead = 0.0f;
+    if (options.visual == "waveform") {
+        pyramid.start(options.audio_file, 64);
+        if (options.exporting && !pyramid.wait()) {
+            std::cout << "Failed to build the waveform pyramid" << std::endl;
+            return -1;
         }
     }
 
-    // scale the sound data
-    printf("%d %d\n", min_sample, max_sample);
-    long long audio_i = 0;
-    const float h = (float) 1 / (float) std::max(abs(max_sample), abs(min_sample));
+    // per frame data is written straight into mapped memory, the texture is
+    // then filled from it on the gpu so the driver never has to copy or wait
+    StreamBuffer uploads;
+    if (!uploads.create(spectrum->getBandCount() * sizeof(float))) {
+        return -1;
+    }
+
+    // the scene pass draws the audio driven geometry, the chosen visual decides what happens after
+    float cur_colour = 0.0f;
+    RenderGraph graph(state);
+    graph.addExternal("spectrum", spectrumTexture);
+    graph.addExternal("waveform", waveformTexture); // swapped for the real one once it is built
+    RenderPass scene;
+    scene.name = "scene";
+    scene.shader = shader;
+    scene.inputs.push_back({"spectrum", "spectrum"});
+    scene.draw = [&]() {
+        // render background with audio data
+        glClearColor(cur_colour, cur_colour, cur_colour, 1.0f); // state setting func
+        glClear(GL_COLOR_BUFFER_BIT); // state using func
 
-    // frame time counter init
-    double last = glfwGetTime();
+        // render the fucking triangle
+        geometry.clear();
+        geometry.add(Shape::Triangle, {0.0f, 0.0f, 1.0f, 1.0f, 0.0f, {1.0f, 1.0f, 1.0f, 1.0f}});
+        state.polygonMode(GL_LINE); // draw wireframe triangle
+        geometry.draw(state);
+    };
+    SpectrumBars bars;
+    if (!buildVisual(options, graph, shaders, state, bars, waveformTexture, playhead, scene)) {
+        return -1;
+    }
+
+    // frame time counter init, the profiler keeps the per frame detail
+    double last = context.getTime();
     int frames = 0;
+    double capture_latency = 0.0; // worst this second
+    std::unique_ptr<FeatureFrame> features = std::make_unique<FeatureFrame>();
+    // a few seconds of frames is plenty for the exit report, a whole run only when it gets dumped
+    FrameProfiler profiler(options.profile_file.empty() ? 1024 : 1 << 19);
+    profiler.initGpu();
+
+    // optionally play the track too, sfml streams it on its own thread
+    sf::Music music;
+    if (options.play) {
+        if (!music.openFromFile(options.audio_file)) {
+            std::cout << "Failed to open audio file for playback" << std::endl;
+            return -1;
+        }
+        music.play();
+    }
+
+    // the audio timeline follows the wall clock, not the frame count,
+    // unless we are exporting, then every frame is exactly 1 / fps apart
+    AudioClock clock;
+    Exporter exporter;
+    long long export_frames = 0;
+    if (options.exporting) {
+        if (!exporter.open(options.export_settings, context.getWidth(), context.getHeight())) {
+            return -1;
+        }
+        export_frames = (long long) std::ceil(duration * options.export_settings.fps);
+        clock.startFixed(1.0 / options.export_settings.fps);
+    } else {
+        clock.start(context.getTime());
+    }
 
     // simple render loop with double buffer
-    while(!glfwWindowShouldClose(window)) {
-        // close if we exceeded the time
-        if (audio_i >= proc_count) {
-            glfwSetWindowShouldClose(window, true);
+    while(!context.shouldClose()) {
+        double now = context.getTime();
+        clock.frameStarted(now);
+
+        // when playing, the sound card is the master clock
+        if (options.play) {
+            if (music.getStatus() == sf::SoundSource::Stopped) {
+                context.requestClose();
+                break;
+            }
+            clock.sync(now, music.getPlayingOffset().asSeconds());
         }
 
-        // calculate current visualisation and update counter
-        float cur_colour = (float) abs(proc_samples[audio_i]) * h;
-        double now = glfwGetTime();
+        // close if we exceeded the time
+        if (options.exporting ? exporter.getFrameCount() >= export_frames : clock.seconds(now) >= duration) {
+            context.requestClose();
+            break;
+        }
+        profiler.beginFrame();
+
+        // pick up the analysed features for when this frame is actually shown,
+        // a live input can only show the newest audio
+        double feature_seconds = live ? std::numeric_limits<double>::infinity() : clock.presentationSeconds(now);
+        bool have_features = analysis.sample(feature_seconds, *features, options.exporting);
+        float current = have_features ? features->rms : 0.0f;
+        cur_colour = normalizer.apply(current, have_features ? features->seconds : 0.0);
+        bool spectrum_changed = false;
+        if (gpu_spectrum) {
+            // straight into the texture, the window is ready by the time the features are
+            if (analysis.takeWindow(clock.presentationSeconds(now), gpu_window.data())) {
+                gpu_spectrum->analyzeWindow(gpu_window.data());
+            }
+        } else {
+            spectrum_changed = have_features && features->band_count > 0;
+        }
+        profiler.mark(ProfileSection::Analysis);
+        uploads.beginFrame();
+        std::size_t upload_offset = 0;
+        float* upload = spectrum_changed ? (float*) uploads.allocate(features->band_count * sizeof(float), upload_offset) : nullptr;
+        if (upload != nullptr) {
+            std::memcpy(upload, features->bands, features->band_count * sizeof(float));
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploads.getId());
+            glTextureSubImage1D(spectrumTexture, 0, 0, (int) features->band_count, GL_RED, GL_FLOAT, (void*) upload_offset);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (waveformTexture == 0 && pyramid.isReady()) {
+            waveformTexture = pyramid.upload();
+            graph.addExternal("waveform", waveformTexture);
+            printf("waveform pyramid with %zu levels, %zu KiB\n", pyramid.getLevelCount(), pyramid.getByteCount() / 1024);
+        }
+        if (!live && duration > 0.0) {
+            playhead = (float) std::min(std::max(clock.presentationSeconds(now) / duration, 0.0), 1.0);
+        }
+        profiler.mark(ProfileSection::Upload);
         frames += 1;
 
-        // this updates every second
+        // this updates every second, the worst frame shows up stutter an average would hide
         if (now - last >= 1.0){ 
-            printf("%d fps\n", (int) frames);
-            printf("%.2f val\n", cur_colour);
+            printf("%d fps, worst frame %.2f ms, %.2f val\n", (int) frames, profiler.takeWorstFrame(), cur_colour);
             frames = 0;
             last += 1.0;
+            long long late = analysis.takeLateFrames();
+            if (late > 0) {
+                printf("analysis fell behind on %lld frames\n", late);
+            }
+            if (live) {
+                printf("capture latency %.1f ms worst + %.1f ms chunks, %llu samples dropped\n",
+                       capture_latency * 1000.0, capture_chunk * 1000.0, capture_buffer.getDropped());
+                capture_latency = 0.0;
+            }
         }
 
         // input
-        processInput(window);
+        if (!context.isHeadless()) {
+            processInput(window);
+        }
+        profiler.mark(ProfileSection::Input);
 
-        // render background with audio data
-        glClearColor(cur_colour, cur_colour, cur_colour, 1.0f); // state setting func
-        glClear(GL_COLOR_BUFFER_BIT); // state using func
-        audio_i += 1;
-        
-        // render the fucking triangle
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // draw wireframe triangle
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+        // swap in edited shaders once they have linked
+        shaders.update();
+
+        // run every pass of the visual into the window or the offscreen target
+        int render_width = context.getWidth(), render_height = context.getHeight();
+        if (!context.isHeadless()) {
+            glfwGetFramebufferSize(window, &render_width, &render_height);
+        }
+        if (render_width > 0 && render_height > 0) {
+            if (!graph.compile(render_width, render_height)) {
+                return -1;
+            }
+            graph.execute(context.isHeadless() ? offscreen.getId() : 0, render_width, render_height);
+        }
+        uploads.endFrame();
+        profiler.mark(ProfileSection::Draw);
+
+        // hand the frame to the exporter, it arrives on the cpu a few frames later
+        if (options.exporting && !exporter.capture(offscreen.getId())) {
+            std::cout << "Failed to export frame" << std::endl;
+            return -1;
+        }
+        profiler.mark(ProfileSection::Export);
 
         // display
-        glfwPollEvents();    
-        glfwSwapBuffers(window);
+        context.pollEvents();
+        profiler.mark(ProfileSection::Events);
+        context.present();
+        profiler.mark(ProfileSection::Swap);
+
+        // capture to photon, from the newest samples arriving to the swap of the frame showing them
+        if (live && have_features) {
+            capture_latency = std::max(capture_latency, captureClock() - features->seconds);
+        }
+        profiler.endFrame();
+    }
+
+    // percentiles go to stderr so they never end up in an exported stream
+    profiler.report(stderr);
+    if (!options.profile_file.empty() && !profiler.dump(options.profile_file)) {
+        std::cout << "Failed to write " << options.profile_file << std::endl;
     }
 
-    // clean up resources and properly exit
-    glfwTerminate();
+    if (options.exporting) {
+        if (!exporter.finish()) {
+            std::cout << "Failed to export frame" << std::endl;
+            return -1;
+        }
+        printf("exported %lld frames\n", exporter.getFrameCount());
+    }
+
+    if (waveformTexture != 0) {
+        glDeleteTextures(1, &waveformTexture);
+    }
+
+    // resources and the context are cleaned up as they go out of scope
     return 0;
 }
 
@@ -218,4 +456,124 @@ void processInput(GLFWwindow *window)
         glfwSetWindowShouldClose(window, true);
 }
 
-// g++ visuals.cpp glad.c -lglfw3 -lGL -lX11 -lpthread -lXrandr -lXi -ldl -lsfml-audio -lsfml-window -lsfml-system; ./a.out c418_sweden.flac
+// turn the scene pass into a whole visual by adding passes after it
+bool buildVisual(const Options& options, RenderGraph& graph, ShaderLibrary& shaders, GLState& state,
+                 SpectrumBars& bars, const unsigned int& waveform_texture, const float& playhead, RenderPass scene)
+{
+    const std::string& name = options.visual;
+
+    // just the scene, straight to the screen
+    if (name == "simple") {
+        graph.addPass(scene);
+        return true;
+    }
+
+    // trails from feeding the last frame back in, then a two pass blur for bloom
+    if (name == "glow") {
+        ShaderProgram* feedback = shaders.load("fullscreenShader.vert", "feedbackShader.frag");
+        ShaderProgram* bright = shaders.load("fullscreenShader.vert", "brightShader.frag");
+        ShaderProgram* blur = shaders.load("fullscreenShader.vert", "blurShader.frag");
+        ShaderProgram* composite = shaders.load("fullscreenShader.vert", "compositeShader.frag");
+        if (feedback == NULL || bright == NULL || blur == NULL || composite == NULL) {
+            return false;
+        }
+
+        scene.output = "scene";
+        graph.addPass(scene);
+
+        graph.addHistory("feedback");
+        RenderPass trails;
+        trails.name = "feedback";
+        trails.shader = feedback;
+        trails.inputs = {{"scene", "scene"}, {"previous", "feedback", true}};
+        trails.output = "feedback";
+        trails.setup = [](unsigned int program) {
+            glUniform1f(glGetUniformLocation(program, "decay"), 0.92f);
+        };
+        graph.addPass(trails);
+
+        RenderPass threshold;
+        threshold.name = "bright";
+        threshold.shader = bright;
+        threshold.inputs = {{"source", "feedback"}};
+        threshold.output = "bright";
+        graph.addPass(threshold);
+
+        RenderPass across;
+        across.name = "blur across";
+        across.shader = blur;
+        across.inputs = {{"source", "bright"}};
+        across.output = "blur_across";
+        across.setup = [](unsigned int program) {
+            glUniform2f(glGetUniformLocation(program, "axis"), 1.0f, 0.0f);
+        };
+        graph.addPass(across);
+
+        RenderPass down = across;
+        down.name = "blur down";
+        down.inputs = {{"source", "blur_across"}};
+        down.output = "blur_down";
+        down.setup = [](unsigned int program) {
+            glUniform2f(glGetUniformLocation(program, "axis"), 0.0f, 1.0f);
+        };
+        graph.addPass(down);
+
+        RenderPass combine;
+        combine.name = "composite";
+        combine.shader = composite;
+        combine.inputs = {{"base", "feedback"}, {"glow", "blur_down"}};
+        graph.addPass(combine);
+        return true;
+    }
+
+    // a bar per slice of the spectrum, all of them in one instanced draw
+    if (name == "bars") {
+        ShaderProgram* program = shaders.load("barShader.vert", "barShader.frag");
+        if (program == NULL || !bars.create(options.bars)) {
+            return false;
+        }
+
+        RenderPass pass;
+        pass.name = "bars";
+        pass.shader = program;
+        pass.inputs = {{"spectrum", "spectrum"}};
+        pass.setup = [&bars](unsigned int program) {
+            bars.setUniforms(program);
+        };
+        pass.draw = [&state, &bars]() {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            bars.draw(state);
+        };
+        graph.addPass(pass);
+        return true;
+    }
+
+    // the scene with an overview of the whole track along the bottom
+    if (name == "waveform") {
+        ShaderProgram* overlay = shaders.load("fullscreenShader.vert", "waveformShader.frag");
+        if (overlay == NULL) {
+            return false;
+        }
+
+        scene.output = "scene";
+        graph.addPass(scene);
+
+        RenderPass overview;
+        overview.name = "waveform";
+        overview.shader = overlay;
+        overview.inputs = {{"scene", "scene"}, {"waveform", "waveform"}};
+        overview.setup = [&waveform_texture, &playhead](unsigned int program) {
+            glUniform1i(glGetUniformLocation(program, "ready"), waveform_texture != 0);
+            glUniform1f(glGetUniformLocation(program, "playhead"), playhead);
+        };
+        graph.addPass(overview);
+        return true;
+    }
+
+    std::cout << "Unknown visual " << name << std::endl;
+    return false;
+}
+
+// g++ visuals.cpp analysis_thread.cpp audio_stream.cpp capture.cpp context.cpp decimate.cpp envelope.cpp envelope_pyramid.cpp export.cpp feature_cache.cpp framebuffer.cpp geometry_batch.cpp gpu_spectrum.cpp normalizer.cpp options.cpp profiler.cpp render_graph.cpp shader.cpp spectrum.cpp spectrum_bars.cpp stream_buffer.cpp glad.c -lglfw3 -lGL -lX11 -lpthread -lXrandr -lXi -ldl -lsfml-audio -lsfml-window -lsfml-system -lz; ./a.out --play c418_sweden.flac
+// add -DVISUALS_EGL -lEGL for surfaceless --headless rendering on machines without a display
@@ -0,0 +1,40 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D scene;
+uniform sampler1D waveform;
+uniform float playhead; // 0 to 1 through the track
+uniform int ready; // 0 until the pyramid has been built and uploaded
+
+// the overview takes the bottom of the screen
+const float strip = 0.2f;
+
+void main()
+{
+    vec3 colour = texture(scene, uv).rgb;
+    if (ready != 0 && uv.y < strip) {
+        // the finest level with no more buckets than pixels, so none are skipped
+        float pixels = float(textureSize(scene, 0).x);
+        float buckets = float(textureSize(waveform, 0));
+        int lod = clamp(int(ceil(log2(max(buckets / pixels, 1.0f)))), 0, textureQueryLevels(waveform) - 1);
+        int width = textureSize(waveform, lod);
+        vec3 bucket = texelFetch(waveform, min(int(uv.x * float(width)), width - 1), lod).rgb;
+
+        // min to max around the centre line, the rms as a brighter core
+        float y = uv.y / strip * 2.0f - 1.0f;
+        vec3 shade = uv.x < playhead ? vec3(0.9f, 0.6f, 0.2f) : vec3(0.5f, 0.5f, 0.6f);
+        colour *= 0.4f;
+        if (y >= bucket.r && y <= bucket.g) {
+            colour = shade * 0.6f;
+        }
+        if (abs(y) <= bucket.b) {
+            colour = shade;
+        }
+        if (abs(uv.x - playhead) * pixels < 1.0f) {
+            colour = vec3(1.0f);
+        }
+    }
+    FragColor = vec4(colour, 1.0f);
+}